@@ -15,6 +15,7 @@
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "ColumnsPlusPlus.h"
+#include "RegularExpression.h"
 #include <chrono>
 #include "resource.h"
 #include "commctrl.h"
@@ -154,6 +155,23 @@ BOOL ColumnsPlusPlusData::aboutDialogProc(HWND hwndDlg, UINT uMsg, WPARAM wParam
                 auto timepoint = std::chrono::sys_seconds(std::chrono::seconds(pnth->FileHeader.TimeDateStamp));
                 version += std::format(L"Build time: {0:%Y} {0:%b} {0:%d} at {0:%H}:{0:%M}:{0:%S} UTC.", timepoint);
                 SetDlgItemText(hwndDlg, IDC_ABOUT_VERSION, version.data());
+                size_t hits = 0, misses = 0, linesSkipped = 0, linesUpdated = 0;
+                for (const auto& [docptr, dd] : documents) {
+                    hits         += dd.widthCache.hits + dd.widthCache.asciiHits;
+                    misses       += dd.widthCache.misses;
+                    linesSkipped += dd.tabstopsApplied.linesSkipped;
+                    linesUpdated += dd.tabstopsApplied.linesUpdated;
+                }
+                std::wstring statistics = std::format(L"Elastic tabstops: {} documents, {:.1f} MB", documents.size(), documentMemoryUsed() / 1048576.0);
+                if (elasticMemoryLimit > 0) statistics += std::format(L" (limit {} MB)", elasticMemoryLimit);
+                if (hits + misses) statistics += std::format(L", {:.0f}% width cache hits", 100.0 * hits / (hits + misses));
+                if (linesSkipped + linesUpdated)
+                    statistics += std::format(L", {:.0f}% of lines already had their tabstops", 100.0 * linesSkipped / (linesSkipped + linesUpdated));
+                statistics += L'.';
+                const size_t regexHits = RegularExpression::cacheHits(), regexMisses = RegularExpression::cacheMisses();
+                if (regexHits + regexMisses) statistics += std::format(L"\nRegular expressions: {} compiled, {} reused from cache.",
+                                                                       regexMisses, regexHits);
+                SetDlgItemText(hwndDlg, IDC_ABOUT_STATISTICS, statistics.data());
             }
 
             SendDlgItemMessage(hwndDlg, IDC_ABOUT_HELP, BCM_SETNOTE, 0, reinterpret_cast<LPARAM>(
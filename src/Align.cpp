@@ -48,13 +48,13 @@ void ColumnsPlusPlusData::alignRight() {
     for (auto row : rs) {
         std::string r;
         for (const auto& cell : row) {
-            if (cell.trimLength() == 0)  r += cell.text() + cell.terminator();
-            else if (cell.isLastInRow()) r += std::string(row.vsMax() - row.vsMin() + cell.leading() + cell.trailing(), ' ') + cell.trim();
+            if (cell.trimLength() == 0)  r.append(cell.text()).append(cell.terminator());
+            else if (cell.isLastInRow()) r.append(row.vsMax() - row.vsMin() + cell.leading() + cell.trailing(), ' ').append(cell.trim());
             else {
                 int padWidth = sci.PointXFromPosition(cell.end() + 1) - sci.PointXFromPosition(cell.end());
                 padWidth = rs.blankCount(padWidth) - (settings.elasticEnabled ? settings.minimumSpaceBetweenColumns : 1);
                 if (padWidth < 0) padWidth = 0;
-                r += std::string(padWidth + cell.leading() + cell.trailing(), ' ') + cell.trim() + '\t';
+                r.append(padWidth + cell.leading() + cell.trailing(), ' ').append(cell.trim()) += '\t';
             }
         }
         if (r != row.text()) row.replace(r);
@@ -19,8 +19,10 @@
 #include <string.h>
 #include "resource.h"
 #include "commctrl.h"
+#include <thread>
 
 void __stdcall catchSelectionMouseUp(HWND hwnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime);
+void __stdcall continueElasticAnalysis(HWND hwnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime);
 
 namespace {
 
@@ -35,6 +37,7 @@ struct ElasticProgressInfo {
     bool isAnalyze    = false;
     bool secondTime   = false;
     bool timerStarted = false;
+    bool resume       = false;  // continue building analysis from firstNeeded instead of starting a new layout
 
     const int ch1440 = data.sci.TextWidth(STYLE_DEFAULT, std::string(1440, '0').data());
     const int tabGap = data.sci.TextWidth(STYLE_DEFAULT, std::string(dd.settings.minimumSpaceBetweenColumns, ' ').data());
@@ -43,19 +46,34 @@ struct ElasticProgressInfo {
     const int tabMin = dd.settings.leadingTabsIndent ? 0 : tabInd;
 
     static constexpr int stepSize = 100;
+    static constexpr Scintilla::Line parallelMinimum = 20000;  // analyze at least this many lines on multiple threads if possible
+    static constexpr Scintilla::Line windowLines     = 2000;   // lines above and below those visible analyzed at once during background analysis
 
     Scintilla::LineCache lineCache;
     enum { LineCacheIgnore, LineCacheRemove, LineCacheRestore } lineCacheStatus;
 
-    std::vector<char>* lineTabsSet;
+    std::string styledLine;  // characters and styles of the line being analyzed, used with proportional fonts
+    const bool  asciiAdvances = data.sci.Technology() == Scintilla::Technology::Default;  // GDI: widths of ASCII text are additive
 
-    ElasticProgressInfo(ColumnsPlusPlusData& data, DocumentData& dd) : data(data), dd(dd), lineTabsSet(data.getLineTabsSet()) {}
+    TabScanner  scanner;
+    const int   codePage      = data.sci.CodePage();
+    const bool  scannerCounts = codePage == 0 || codePage == CP_UTF8;  // TabScanner counts characters as Scintilla does
+
+    LineRuns* lineTabsSet;
+    TabLayout* analysis = &dd.tabLayouts;
+
+    ElasticProgressInfo(ColumnsPlusPlusData& data, DocumentData& dd) : data(data), dd(dd), lineTabsSet(data.getLineTabsSet(dd)) {}
 
     Scintilla::Line processed() const { return step * stepSize + (secondTime ? lastNeeded - firstNeeded + 1 : 0); }
     Scintilla::Line objective() const { return lastNeeded - firstNeeded + (lastMonospaceFail < 0 ? 0 : lastMonospaceFail - firstNeeded + 1); }
 
     bool analyzeTabstops();
+    bool scanLine(const DocumentSnapshot& text, Scintilla::Line lineNum, Scintilla::Position& begin, size_t& first);
+    int  layoutWidth(Scintilla::Position begin, size_t first, size_t cell);
+    int  cellWidthAt(Scintilla::Line lineNum, size_t level);
+    int  cellWidth(Scintilla::Position lineStart, size_t from, size_t to);
     bool setTabstops(bool stepless = false);
+    void applyTabstops(Scintilla::Line lineNum, const std::vector<int>& tabs);
 
 };
 
@@ -137,40 +155,309 @@ INT_PTR CALLBACK elasticProgressDialogProc(HWND hwndDlg, UINT uMsg, WPARAM wPara
 
 }
 
+
+bool runParallelAnalysis(ElasticProgressInfo& epi) {
+    auto& sci = epi.data.sci;
+    auto& settings = epi.dd.settings;
+    if (!epi.dd.assumeMonospace || epi.lastNeeded - epi.firstNeeded < ElasticProgressInfo::parallelMinimum) return false;
+    const unsigned int threads = std::thread::hardware_concurrency();
+    if (threads < 2) return false;
+    const int codePage = sci.CodePage();
+    if (codePage != 0 && codePage != CP_UTF8) return false;
+    if (sci.LineEndTypesActive() != Scintilla::LineEndType::Default) return false;
+    const MonospaceMetrics metrics = { epi.ch1440, epi.tabGap, epi.tabInd, epi.tabMin,
+                                       settings.leadingTabsIndent, settings.lineUpAll, settings.treatEolAsTab };
+    TabLayout analysis = analyzeMonospace(DocumentSnapshot(sci), sci.PositionFromLine(epi.firstNeeded), sci.LineEnd(epi.lastNeeded),
+                                          epi.firstNeeded, metrics, threads);
+    if (epi.resume) epi.analysis->append(analysis, settings.lineUpAll);
+    else *epi.analysis = std::move(analysis);
+    return true;
+}
+
+
+// Run analysis until it is complete or it is projected to take longer than elasticProgressTime.  In that case, if deferrable is
+// set, return AnalysisDeferred, leaving the analysis done so far in epi for background analysis to continue; otherwise show the
+// progress dialog, from which the user can cancel.
+
+enum AnalysisResult { AnalysisComplete, AnalysisCancelled, AnalysisDeferred };
+
+// Record the time taken to analyze lines from epi.firstNeeded up to (not including) endLine in the throughput model.
+
+void recordThroughput(ElasticProgressInfo& epi, Scintilla::Line endLine, uint64_t started) {
+    auto& sci = epi.data.sci;
+    endLine = std::min(endLine, epi.lastNeeded + 1);
+    if (endLine <= epi.firstNeeded) return;
+    epi.data.throughput.record(epi.dd.settings.profileName, epi.dd.assumeMonospace, endLine - epi.firstNeeded,
+                               sci.PositionFromLine(endLine) - sci.PositionFromLine(epi.firstNeeded), GetTickCount64() - started);
+}
+
+AnalysisResult runAnalysis(ElasticProgressInfo& epi, bool deferrable = false) {
+    ColumnsPlusPlusData& data = epi.data;
+    const uint64_t started = GetTickCount64();
+    if (runParallelAnalysis(epi)) {
+        recordThroughput(epi, epi.lastNeeded + 1, started);
+        return AnalysisComplete;
+    }
+    epi.isAnalyze = true;
+    ProgressEstimate estimate(started);
+    AnalysisResult result = AnalysisComplete;
+    while (epi.analyzeTabstops()) {
+        if (!estimate.exceeds(GetTickCount64(), epi.objective() - epi.processed(), epi.stepSize, data.elasticProgressTime)) continue;
+        if (deferrable) result = AnalysisDeferred;
+        else {
+            // The dialog runs a message loop, in which the background analysis timer could otherwise replace the layout being made.
+            const bool wasForeground = data.foregroundAnalysis;
+            data.foregroundAnalysis = true;
+            result = DialogBoxParam(data.dllInstance, MAKEINTRESOURCE(IDD_ELASTIC_PROGRESS), data.nppData._nppHandle,
+                                    elasticProgressDialogProc, reinterpret_cast<LPARAM>(&epi)) == 0 ? AnalysisComplete : AnalysisCancelled;
+            data.foregroundAnalysis = wasForeground;
+        }
+        break;
+    }
+    recordThroughput(epi, result == AnalysisComplete ? epi.lastNeeded + 1 : epi.firstNeeded + epi.step * epi.stepSize, started);
+    return result;
+}
+
 } // end unnamed namespace
 
 
+void CellWidths::add(int w) {
+    if (!exact) return;
+    int i = 0;
+    while (i < size && count[i] && width[i] > w) ++i;
+    if (i == size || (!count[i] && partial)) /* narrower than all listed widths, and there are uncounted cells */ {
+        partial = true;
+        return;
+    }
+    if (count[i] && width[i] == w) {
+        ++count[i];
+        return;
+    }
+    if (count[size - 1]) partial = true;
+    for (int j = size - 1; j > i; --j) {
+        width[j] = width[j - 1];
+        count[j] = count[j - 1];
+    }
+    width[i] = w;
+    count[i] = 1;
+}
+
+
+bool CellWidths::remove(int w) {
+    if (!exact) return false;
+    int used = 0;
+    while (used < size && count[used]) ++used;
+    for (int i = 0; i < used; ++i) if (width[i] == w) {
+        if (--count[i] == 0) {
+            for (int j = i; j < size - 1; ++j) {
+                width[j] = width[j + 1];
+                count[j] = count[j + 1];
+            }
+            count[size - 1] = 0;
+            if (used == 1 && partial) exact = false;  // the widest of the uncounted cells is not known
+        }
+        return exact;
+    }
+    if (partial && used && w < width[used - 1]) return true;
+    exact = false;
+    return false;
+}
+
+
+// Combine the widths from another block, as when two blocks are joined.  Listed widths narrower than the narrowest listed width
+// of a partial list are dropped, since cells of unknown width might lie between them.
+
+void CellWidths::merge(const CellWidths& other) {
+    if (!exact || !other.exact) {
+        exact = false;
+        return;
+    }
+    int combinedWidth[2 * size], combinedCount[2 * size];
+    int n = 0, threshold = INT_MIN;
+    for (const CellWidths* source : { static_cast<const CellWidths*>(this), &other }) for (int i = 0; i < size && source->count[i]; ++i) {
+        if (source->partial && (i == size - 1 || !source->count[i + 1])) threshold = std::max(threshold, source->width[i]);
+        int j = 0;
+        while (j < n && combinedWidth[j] != source->width[i]) ++j;
+        if (j == n) {
+            combinedWidth[n] = source->width[i];
+            combinedCount[n++] = 0;
+        }
+        combinedCount[j] += source->count[i];
+    }
+    partial = partial || other.partial;
+    for (int i = 0; i < size; ++i) {
+        int widest = -1;
+        for (int j = 0; j < n; ++j) if (combinedCount[j] && combinedWidth[j] >= threshold && (widest < 0 || combinedWidth[j] > combinedWidth[widest])) widest = j;
+        if (widest < 0) {
+            count[i] = 0;
+            continue;
+        }
+        width[i] = combinedWidth[widest];
+        count[i] = combinedCount[widest];
+        combinedCount[widest] = 0;
+    }
+    for (int j = 0; j < n; ++j) if (combinedCount[j]) partial = true;
+}
+
+
+// Append the blocks from next, which must begin on the line following the last line covered by this layout, joining blocks
+// which continue across the boundary.
+
+void TabLayout::append(TabLayout& next, bool lineUpAll) {
+    if (levels.size() < next.levels.size()) levels.resize(next.levels.size());
+    bool   joined       = true;                  // the last block of the previous level was joined with the first from next
+    size_t joinedParent = TabLayoutBlock::npos;  // index of that block in the previous level
+    size_t parentOffset = 0;                     // amount to add to parent indices in blocks from next
+    for (size_t level = 0; level < next.levels.size(); ++level) {
+        std::vector<TabLayoutBlock>& blocks = levels[level];
+        std::vector<TabLayoutBlock>& more   = next.levels[level];
+        const size_t oldSize = blocks.size();
+        joined = joined && oldSize && !more.empty() && blocks.back().parent == joinedParent
+              && more.front().parent == (level ? 0 : TabLayoutBlock::npos)
+              && (lineUpAll || blocks.back().lastLine + 1 == more.front().firstLine);
+        size_t i = 0;
+        if (joined) {
+            blocks.back().lastLine = more.front().lastLine;
+            blocks.back().width    = std::max(blocks.back().width, more.front().width);
+            blocks.back().cells.merge(more.front().cells);
+            i = 1;
+        }
+        for (; i < more.size(); ++i) {
+            blocks.push_back(more[i]);
+            if (level) blocks.back().parent += parentOffset;
+        }
+        joinedParent = oldSize - 1;
+        parentOffset = joined ? oldSize - 1 : oldSize;
+    }
+}
+
+
+// Replace the blocks in lines firstLine through lastLine (which must not cut across any block) with the blocks from replacement,
+// which were built for the same lines after linesAdded lines were added to them; blocks following those lines are renumbered.
+// If fromLevel is not zero, only blocks in that level and those after it are replaced: then linesAdded must be zero, the lines
+// must lie within one block in the previous level, and replacement must have a single block spanning the lines in that level.
+
+void TabLayout::splice(Scintilla::Line firstLine, Scintilla::Line lastLine, Scintilla::Line linesAdded, TabLayout& replacement, size_t fromLevel) {
+    const size_t levelCount = std::max(levels.size(), replacement.levels.size());
+    if (levels.size() < levelCount) levels.resize(levelCount);
+    size_t parentOffset = fromLevel ? lowerBound(fromLevel - 1, firstLine) : 0;  // index in the previous level of the first replacement block
+    ptrdiff_t parentShift = 0;  // change in the number of blocks in the previous level
+    for (size_t level = fromLevel; level < levelCount; ++level) {
+        std::vector<TabLayoutBlock>& blocks = levels[level];
+        const size_t first = lowerBound(level, firstLine);
+        size_t last = first;
+        while (last < blocks.size() && blocks[last].firstLine <= lastLine) ++last;
+        for (size_t i = last; i < blocks.size(); ++i) {
+            blocks[i].firstLine += linesAdded;
+            blocks[i].lastLine  += linesAdded;
+            if (level) blocks[i].parent += parentShift;
+        }
+        blocks.erase(blocks.begin() + first, blocks.begin() + last);
+        const size_t added = level < replacement.levels.size() ? replacement.levels[level].size() : 0;
+        if (added) {
+            std::vector<TabLayoutBlock>& inserts = replacement.levels[level];
+            if (level) for (TabLayoutBlock& tlb : inserts) tlb.parent += parentOffset;
+            blocks.insert(blocks.begin() + first, inserts.begin(), inserts.end());
+        }
+        parentOffset = first;
+        parentShift  = static_cast<ptrdiff_t>(added) - static_cast<ptrdiff_t>(last - first);
+    }
+}
+
+
+// Remove the blocks which might depend on line or any line after it, so that analysis can continue from the returned line:
+// top-level blocks that end before line are kept along with the blocks within them; any other blocks are removed.
+
+Scintilla::Line TabLayout::truncate(Scintilla::Line line) {
+    if (empty()) return line;
+    const size_t i = lowerBound(0, line);
+    if (i < levels[0].size()) line = std::min(line, levels[0][i].firstLine);
+    for (size_t level = 0; level < levels.size(); ++level) levels[level].erase(levels[level].begin() + lowerBound(level, line), levels[level].end());
+    return line;
+}
+
+
+// Follow a change in which lines firstChanged through lastChanged (current numbering) replaced lines firstChanged through
+// lastChanged - linesAdded: hashes after the change are moved with their lines, and those for the changed lines are forgotten.
+
+void AppliedTabstops::shift(Scintilla::Line firstChanged, Scintilla::Line lastChanged, Scintilla::Line linesAdded) {
+    if (hashes.empty()) return;
+    if (firstChanged < 0 || firstChanged > size() || firstChanged - linesAdded > size()) {
+        hashes.clear();
+        return;
+    }
+    if (linesAdded > 0) hashes.insert(hashes.begin() + firstChanged, linesAdded, 0);
+    if (linesAdded < 0) hashes.erase(hashes.begin() + firstChanged, hashes.begin() + firstChanged - linesAdded);
+    std::fill(hashes.begin() + firstChanged, hashes.begin() + std::min(lastChanged + 1, size()), 0);
+}
+
+
+uint64_t AppliedTabstops::hash(const std::vector<int>& tabs) {
+    uint64_t h = 14695981039346656037ULL;  // 64-bit FNV-1a over the tabstop positions
+    for (int tab : tabs) h = (h ^ static_cast<uint32_t>(tab)) * 1099511628211ULL;
+    return h ? h : 1;
+}
+
+
+void AnalysisThroughput::record(const std::wstring& profile, bool monospace, uint64_t lines, uint64_t bytes, uint64_t milliseconds) {
+    Rate& rate = rates[{profile, monospace}];
+    rate.pendingLines += lines;
+    rate.pendingBytes += bytes;
+    rate.pendingTime  += milliseconds;
+    if (rate.pendingTime < sampleTime) return;
+    const double linesPerSecond = 1000.0 * rate.pendingLines / rate.pendingTime;
+    const double bytesPerSecond = 1000.0 * rate.pendingBytes / rate.pendingTime;
+    if (rate.samples) /* exponential moving average, so the model follows changes in the machine's load or the fonts in use */ {
+        rate.linesPerSecond = 0.75 * rate.linesPerSecond + 0.25 * linesPerSecond;
+        rate.bytesPerSecond = 0.75 * rate.bytesPerSecond + 0.25 * bytesPerSecond;
+    }
+    else {
+        rate.linesPerSecond = linesPerSecond;
+        rate.bytesPerSecond = bytesPerSecond;
+    }
+    if (rate.samples < minimumSamples) ++rate.samples;
+    rate.pendingLines = rate.pendingBytes = rate.pendingTime = 0;
+}
+
+
+double AnalysisThroughput::predict(const std::wstring& profile, bool monospace, uint64_t lines, uint64_t bytes) const {
+    auto found = rates.find({profile, monospace});
+    if (found == rates.end()) return -1;
+    const Rate& rate = found->second;
+    if (rate.samples < minimumSamples || rate.linesPerSecond <= 0 || rate.bytesPerSecond <= 0) return -1;
+    return std::max(lines / rate.linesPerSecond, bytes / rate.bytesPerSecond);
+}
+
+
 void ColumnsPlusPlusData::setTabstops(DocumentData& dd, Scintilla::Line firstNeeded, Scintilla::Line lastNeeded, bool skipChooseCaretX) {
+    if ( firstNeeded != -1 && dd.backgroundNextLine >= 0
+      && (firstNeeded < dd.windowFirstLine || lastNeeded < 0 || lastNeeded > dd.windowLastLine) ) {
+        if (dd.paged) analyzeWindow(dd, firstNeeded, lastNeeded < 0 ? sci.LineCount() - 1 : lastNeeded);
+                 else finishBackgroundAnalysis(dd);
+    }
     ElasticProgressInfo epi(*this, dd);
     if (!epi.lineTabsSet) return;
     const Scintilla::Line lineCount     = sci.LineCount();
     const Scintilla::Line linesOnScreen = sci.LinesOnScreen();
-    if (epi.lineTabsSet->size() != static_cast<size_t>(lineCount)) epi.lineTabsSet->assign(lineCount, 0);
+    if (epi.lineTabsSet->size() != lineCount) epi.lineTabsSet->reset(lineCount);
+    if (dd.tabstopsApplied.size() != lineCount) dd.tabstopsApplied.reset(lineCount);
     epi.lineCacheStatus = ElasticProgressInfo::LineCacheRemove;
-    if (firstNeeded == -1) {
-        epi.firstNeeded = sci.FirstVisibleLine();
-        epi.lastNeeded  = std::min(epi.firstNeeded + linesOnScreen, lineCount - 1);
+    if (firstNeeded == -1) /* visible lines, plus a band above and below so that scrolling a short distance finds them ready */ {
+        const Scintilla::Line firstVisible = sci.FirstVisibleLine();
+        const Scintilla::Line prefetch     = std::max(elasticPrefetchLines, 0);
+        epi.firstNeeded = std::max(sci.DocLineFromVisible(firstVisible) - prefetch, Scintilla::Line(0));
+        epi.lastNeeded  = std::min(sci.DocLineFromVisible(firstVisible + linesOnScreen) + prefetch, lineCount - 1);
         epi.setTabstops(true);
     }
     else {
         epi.firstNeeded = firstNeeded;
         epi.lastNeeded  = (lastNeeded < 0 || lastNeeded >= lineCount) ? lineCount - 1 : lastNeeded;
-        unsigned long long before, after;
-        before = GetTickCount64();
-        double timeLimit = elasticProgressTime;
-        int stepCount = 0;
+        ProgressEstimate estimate(GetTickCount64());
         while (epi.setTabstops()) {
-            after = GetTickCount64();
-            ++stepCount;
-            if (after - before < 20) continue;
-            double projected = static_cast<double>(epi.objective() - epi.processed()) * static_cast<double>(after - before)
-                / (1000 * static_cast<double>(stepCount * epi.stepSize));
-            if (projected > timeLimit) {
+            if (estimate.exceeds(GetTickCount64(), epi.objective() - epi.processed(), epi.stepSize, elasticProgressTime)) {
                 DialogBoxParam(dllInstance, MAKEINTRESOURCE(IDD_ELASTIC_PROGRESS), nppData._nppHandle, elasticProgressDialogProc, reinterpret_cast<LPARAM>(&epi));
                 break;
             }
-            before = after;
-            stepCount = 0;
         }
     }
     if (!skipChooseCaretX) /* avoid ChooseCaretX when nothing has changed, so up/down keys don't lose position crossing short lines */ {
@@ -185,13 +472,12 @@ bool ElasticProgressInfo::setTabstops(bool stepless) {
     auto& sci = data.sci;
     Scintilla::Line firstToProcess = stepless ? firstNeeded : firstNeeded + step * stepSize;
     Scintilla::Line lastToProcess  = stepless ? lastNeeded  : std::min(lastNeeded, firstToProcess + stepSize - 1);
-    size_t tlbIndex = 0;
-    for (Scintilla::Line lineNum = firstToProcess; lineNum <= lastToProcess; ++lineNum) {
-        if ((*lineTabsSet)[lineNum]) continue;
-        (*lineTabsSet)[lineNum] = 1;
-        while (tlbIndex < dd.tabLayouts.size() && dd.tabLayouts[tlbIndex].lastLine < lineNum) ++tlbIndex;
-        if (tlbIndex >= dd.tabLayouts.size() || dd.tabLayouts[tlbIndex].firstLine > lineNum) {
-            sci.ClearTabStops(lineNum);
+    for ( Scintilla::Line lineNum = lineTabsSet->nextClear(firstToProcess); lineNum <= lastToProcess;
+          lineNum = lineTabsSet->nextClear(lineNum + 1) ) {
+        lineTabsSet->set(lineNum);
+        TabLayoutBlock* const firstBlock = dd.tabLayouts.find(lineNum, 0);
+        if (!firstBlock) {
+            applyTabstops(lineNum, {});
             continue;
         }
         Scintilla::Position lineStarts = sci.PositionFromLine(lineNum);
@@ -208,42 +494,24 @@ bool ElasticProgressInfo::setTabstops(bool stepless) {
         int eolLimit = 0;
         {
             int tabstop = 0;
-            const TabLayoutBlock* tlb = &dd.tabLayouts[tlbIndex];
+            size_t level = 0;
+            const TabLayoutBlock* tlb = firstBlock;
             for (size_t tabchar = leadingTabCount; tabchar = line.find_first_of('\t', tabchar), tabchar != std::string::npos; ++tabchar) {
                 tabstop += tlb->width;
                 tabs.push_back(tabstop);
                 tabOffsets.push_back(tabchar);
-                size_t i = 0;
-                while (i < tlb->right.size() && tlb->right[i].lastLine < lineNum) ++i;
-                if (i >= tlb->right.size() || tlb->right[i].firstLine > lineNum) break;
-                tlb = &tlb->right[i];
+                const TabLayoutBlock* right = dd.tabLayouts.find(lineNum, level + 1);
+                if (!right) break;
+                tlb = right;
+                ++level;
             }
-            if (dd.settings.treatEolAsTab && tlb->right.size()) eolLimit = tabstop + tlb->width;
+            if (dd.settings.treatEolAsTab && dd.tabLayouts.hasRight(*tlb, level)) eolLimit = tabstop + tlb->width;
         }
         if (leadingTabCount == tabs.size()) {
-            sci.ClearTabStops(lineNum);
+            applyTabstops(lineNum, {});
             if (!eolLimit) continue;
         }
-        else {
-            bool unchanged = true;
-            int position = 0;
-            for (size_t i = 0; i < tabs.size(); ++i) {
-                position = sci.GetNextTabStop(lineNum, position);
-                if (position != tabs[i]) {
-                    unchanged = false;
-                    break;
-                }
-            }
-            if (!unchanged) {
-                if (lineCacheStatus == LineCacheRemove) {
-                    lineCache       = sci.LayoutCache();
-                    lineCacheStatus = LineCacheRestore;
-                    sci.SetLayoutCache(Scintilla::LineCache::None);
-                }
-                sci.ClearTabStops(lineNum);
-                for (size_t i = 0; i < tabs.size(); ++i) sci.AddTabStop(lineNum, tabs[i]);
-            }
-        }
+        else applyTabstops(lineNum, tabs);
         if (!secondTime && dd.assumeMonospace) {
             int pxStart = sci.PointXFromPosition(lineStarts);
             if ( (tabs.size() > leadingTabCount && tabs.back() < sci.PointXFromPosition(lineStarts + tabOffsets.back() + 1) - pxStart)
@@ -253,19 +521,18 @@ bool ElasticProgressInfo::setTabstops(bool stepless) {
                 bool lineTabsInvalidated = false;
                 size_t tabIndex = leadingTabCount;
                 size_t from = 0;
-                for (TabLayoutBlock* tlb = &dd.tabLayouts[tlbIndex]; tabIndex < tabOffsets.size(); ++tabIndex) {
+                for (TabLayoutBlock* tlb = firstBlock; tabIndex < tabOffsets.size(); ++tabIndex) {
                     int width = data.unwrappedWidth(lineStarts + from, lineStarts + tabOffsets[tabIndex]) + tabGap;
                     if (width > tlb->width) {
                         tlb->width = width;
+                        tlb->cells.exact = false;
                         if (!lineTabsInvalidated) {
-                            for (Scintilla::Line ln = tlb->firstLine; ln <= tlb->lastLine; ++ln) (*lineTabsSet)[ln] = 0;
+                            lineTabsSet->clear(tlb->firstLine, tlb->lastLine);
                             lineTabsInvalidated = true;
                         }
                     }
-                    size_t i = 0;
-                    if (i < tlb->right.size() && tlb->right[i].lastLine < lineNum) ++i;
-                    if (i >= tlb->right.size() || tlb->right[i].firstLine > lineNum) break;
-                    tlb = &tlb->right[i];
+                    tlb = dd.tabLayouts.find(lineNum, tabIndex - leadingTabCount + 1);
+                    if (!tlb) break;
                     from = tabOffsets[tabIndex] + 1;
                 }
             }
@@ -283,11 +550,50 @@ bool ElasticProgressInfo::setTabstops(bool stepless) {
 }
 
 
+// Set the tabstops for a line, unless the hash of those last set shows they are already in place.  When the hash is not known,
+// the tabstops are read from Scintilla and compared.
+
+void ElasticProgressInfo::applyTabstops(Scintilla::Line lineNum, const std::vector<int>& tabs) {
+    auto& sci = data.sci;
+    AppliedTabstops& applied = dd.tabstopsApplied;
+    const uint64_t hash = AppliedTabstops::hash(tabs);
+    const uint64_t known = applied.get(lineNum);
+    bool unchanged = known == hash;
+    if (!known) {
+        unchanged = true;
+        int position = 0;
+        for (size_t i = 0; unchanged && i < tabs.size(); ++i) {
+            position = sci.GetNextTabStop(lineNum, position);
+            if (position != tabs[i]) unchanged = false;
+        }
+        if (unchanged && sci.GetNextTabStop(lineNum, position)) unchanged = false;
+    }
+    applied.put(lineNum, hash);
+    if (unchanged) {
+        ++applied.linesSkipped;
+        return;
+    }
+    ++applied.linesUpdated;
+    if (lineCacheStatus == LineCacheRemove) {
+        lineCache       = sci.LayoutCache();
+        lineCacheStatus = LineCacheRestore;
+        sci.SetLayoutCache(Scintilla::LineCache::None);
+    }
+    if (lineNum == data.wrapBreaks.line) data.wrapBreaks.clear();
+    sci.ClearTabStops(lineNum);
+    for (size_t i = 0; i < tabs.size(); ++i) sci.AddTabStop(lineNum, tabs[i]);
+}
+
+
 void ColumnsPlusPlusData::analyzeTabstops(DocumentData& dd) {
     ElasticProgressInfo epi(*this, dd);
     if (!epi.lineTabsSet) return;
+    if (fontSpacingChange(dd)) dd.widthCache.clear();
     dd.elasticAnalysisRequired   = false;
     dd.deleteWithoutLayoutChange = false;
+    dd.changedFirstLine  = -1;
+    dd.changedLastLine   = -1;
+    dd.changedLinesAdded = 0;
     dd.width24b = sci.TextWidth(STYLE_DEFAULT, "                        ");
     dd.width24d = sci.TextWidth(STYLE_DEFAULT, "123456789012345678901234");
     dd.width24w = sci.TextWidth(STYLE_DEFAULT, "WWWWWWWWWWWWWWWWWWWWWWWW");
@@ -296,64 +602,348 @@ void ColumnsPlusPlusData::analyzeTabstops(DocumentData& dd) {
     const int ccsym = settings.monospaceNoMnemonics && dd.assumeMonospace ? '!' : 0;
     const Scintilla::Line lineCount = sci.LineCount();
     if (bothViewsShowSameDocument()) {
-        view1TabsSet.assign(lineCount, 0);
-        view2TabsSet.assign(lineCount, 0);
         SendMessage(nppData._scintillaMainHandle  , SCI_SETCONTROLCHARSYMBOL, ccsym, 0);
         SendMessage(nppData._scintillaSecondHandle, SCI_SETCONTROLCHARSYMBOL, ccsym, 0);
     }
+    else sci.SetControlCharSymbol(ccsym);
+    epi.lineTabsSet->reset(lineCount);
+    dd.paged = false;
+    // A document whose previous layout was too large to store is not hashed to look for a stored layout.  If the hash is not
+    // already known, the document is analyzed; should that be deferred, the background timer hashes it first and looks again.
+    dd.layoutCacheStore = false;
+    dd.layoutCacheFind  = lineCount >= LayoutCache::minimumLines && LayoutCache::fits(dd.tabLayouts);
+    if (dd.layoutCacheFind && dd.contentHashed == sci.Length()) {
+        dd.layoutCacheFind = false;
+        if (layoutCache.find(layoutCacheKey(dd), dd.tabLayouts)) {
+            dd.windowFirstLine    = 0;
+            dd.windowLastLine     = -1;
+            dd.backgroundNextLine = -1;
+            return;
+        }
+    }
+    if (dd.streaming) {
+        dd.backgroundLayout.clear();
+        dd.backgroundNextLine = 0;
+        startBackgroundAnalysis(dd);
+        return;
+    }
+    dd.windowFirstLine = 0;
+    dd.windowLastLine  = -1;
+    dd.backgroundNextLine = -1;
+    epi.firstNeeded = 0;
+    epi.lastNeeded  = lineCount - 1;
+    switch (runAnalysis(epi, true)) {
+    case AnalysisComplete:
+        dd.layoutCacheFind = false;
+        cacheLayout(dd);
+        if (dd.layoutCacheStore && !elasticBackgroundTimer) elasticBackgroundTimer = SetTimer(0, 0, 10, continueElasticAnalysis);
+        break;
+    case AnalysisDeferred:
+        dd.backgroundLayout   = std::move(dd.tabLayouts);
+        dd.backgroundNextLine = epi.firstNeeded + epi.step * epi.stepSize;
+        startBackgroundAnalysis(dd);
+        break;
+    case AnalysisCancelled:
+        dd.layoutCacheFind = false;
+        break;
+    }
+}
+
+
+// Re-analyze only the lines affected by a change to lines firstChanged through lastChanged (numbered as they are after the change),
+// which added linesAdded lines (negative if lines were removed).  Falls back to full analysis when that is required anyway.
+
+void ColumnsPlusPlusData::analyzeTabstops(DocumentData& dd, Scintilla::Line firstChanged, Scintilla::Line lastChanged, Scintilla::Line linesAdded) {
+    if (dd.elasticAnalysisRequired || dd.settings.lineUpAll || fontSpacingChange(dd)) {
+        analyzeTabstops(dd);
+        return;
+    }
+    noteChangedLines(dd, firstChanged, lastChanged, linesAdded);
+    analyzeChangedLines(dd);
+}
+
+
+// Record a change to be processed by analyzeChangedLines, merging it with any change already pending.
+
+void ColumnsPlusPlusData::noteChangedLines(DocumentData& dd, Scintilla::Line firstChanged, Scintilla::Line lastChanged, Scintilla::Line linesAdded) {
+    dd.tabstopsApplied.shift(firstChanged, lastChanged, linesAdded);  // changed lines may have been removed and inserted again
+    if (dd.backgroundNextLine > firstChanged) dd.backgroundNextLine = dd.backgroundLayout.truncate(firstChanged);
+    if (dd.changedFirstLine < 0) {
+        dd.changedFirstLine  = firstChanged;
+        dd.changedLastLine   = lastChanged;
+        dd.changedLinesAdded = linesAdded;
+        return;
+    }
+    Scintilla::Line pendingLast = dd.changedLastLine < firstChanged               ? dd.changedLastLine
+                                : dd.changedLastLine > lastChanged - linesAdded ? dd.changedLastLine + linesAdded
+                                                                                  : lastChanged;
+    dd.changedFirstLine   = std::min(dd.changedFirstLine, firstChanged);
+    dd.changedLastLine    = std::max(pendingLast, lastChanged);
+    dd.changedLinesAdded += linesAdded;
+}
+
+
+// Bring tabLayouts up to date for changes recorded by noteChangedLines.  The top-level blocks touching the changed lines are discarded;
+// the lines they covered, along with the changed lines, are analyzed again; and the blocks that follow are renumbered.  Since the
+// lines just outside that range belong to no block, they separate it from the rest of the document and the result is the same as
+// from a full analysis.  Returns false if there was nothing to do.
+
+bool ColumnsPlusPlusData::analyzeChangedLines(DocumentData& dd) {
+    if (dd.changedFirstLine < 0) return false;
+    if (dd.elasticAnalysisRequired || dd.settings.lineUpAll || fontSpacingChange(dd)) {
+        analyzeTabstops(dd);
+        return true;
+    }
+    ElasticProgressInfo epi(*this, dd);
+    if (!epi.lineTabsSet) return false;
+    const Scintilla::Line firstChanged = dd.changedFirstLine;
+    const Scintilla::Line lastChanged  = dd.changedLastLine;
+    const Scintilla::Line linesAdded   = dd.changedLinesAdded;
+    dd.changedFirstLine  = -1;
+    dd.changedLastLine   = -1;
+    dd.changedLinesAdded = 0;
+    const Scintilla::Line lineCount = sci.LineCount();
+    epi.firstNeeded = firstChanged;
+    epi.lastNeeded  = lastChanged;
+    if (!dd.tabLayouts.empty()) {
+        const std::vector<TabLayoutBlock>& blocks = dd.tabLayouts.levels[0];
+        size_t first = dd.tabLayouts.lowerBound(0, firstChanged - 1);
+        size_t last  = first;
+        while (last < blocks.size() && blocks[last].firstLine <= lastChanged - linesAdded + 1) ++last;
+        if (first < last) {
+            epi.firstNeeded = std::min(firstChanged, blocks[first].firstLine);
+            epi.lastNeeded  = std::max(lastChanged, blocks[last - 1].lastLine + linesAdded);
+        }
+    }
+    if (epi.lastNeeded >= lineCount) epi.lastNeeded = lineCount - 1;
+    TabLayout analysis;
+    epi.analysis = &analysis;
+    if (runAnalysis(epi, true) == AnalysisDeferred) /* continue in the background from the first line that must be analyzed again */ {
+        if (dd.backgroundNextLine < 0) {
+            dd.backgroundLayout   = dd.tabLayouts;
+            dd.backgroundNextLine = dd.backgroundLayout.truncate(epi.firstNeeded);
+        }
+        startBackgroundAnalysis(dd);
+        return true;
+    }
+    dd.tabLayouts.splice(epi.firstNeeded, epi.lastNeeded - linesAdded, linesAdded, analysis);
+    LineRuns& lineTabsSet = *epi.lineTabsSet;
+    if (lineTabsSet.size() != lineCount - linesAdded) lineTabsSet.reset(lineCount);
     else {
-        sci.SetControlCharSymbol(ccsym);
-        epi.lineTabsSet->assign(lineCount, 0);
+        if (linesAdded > 0) lineTabsSet.insert(firstChanged, linesAdded);
+        if (linesAdded < 0) lineTabsSet.erase(firstChanged, -linesAdded);
+        lineTabsSet.clear(epi.firstNeeded, epi.lastNeeded);
+    }
+    return true;
+}
+
+
+// Bring tabLayouts up to date after a paste which inserted text, not including line ends, in lines firstChanged through lastChanged,
+// all at or after the tab which begins the given level.  Blocks in lower levels are unchanged, so only the blocks in that level
+// which touch the changed lines, and the blocks within them, need to be analyzed again; in a large block of tabbed lines this is
+// much less than the top-level blocks analyzeChangedLines would use.  Returns false if this cannot be done.
+
+bool ColumnsPlusPlusData::analyzePastedLines(DocumentData& dd, Scintilla::Line firstChanged, Scintilla::Line lastChanged, size_t level) {
+    if ( !level || dd.elasticAnalysisRequired || dd.settings.lineUpAll || dd.changedLinesAdded || dd.backgroundNextLine >= 0
+      || fontSpacingChange(dd) ) return false;
+    TabLayout& layout = dd.tabLayouts;
+    const TabLayoutBlock* parent = layout.find(firstChanged, level - 1);
+    if (!parent || parent->lastLine < lastChanged) return false;
+    Scintilla::Line firstLine = firstChanged;
+    Scintilla::Line lastLine  = lastChanged;
+    if (level < layout.levels.size()) {
+        const std::vector<TabLayoutBlock>& blocks = layout.levels[level];
+        for (size_t i = layout.lowerBound(level, firstChanged - 1); i < blocks.size() && blocks[i].firstLine <= lastChanged + 1; ++i)
+            if (blocks[i].firstLine >= parent->firstLine && blocks[i].lastLine <= parent->lastLine) {
+                firstLine = std::min(firstLine, blocks[i].firstLine);
+                lastLine  = std::max(lastLine , blocks[i].lastLine );
+            }
+    }
+    ElasticProgressInfo epi(*this, dd);
+    if (!epi.lineTabsSet) return false;
+    TabLayout analysis;
+    epi.analysis    = &analysis;
+    epi.firstNeeded = firstLine;
+    epi.lastNeeded  = lastLine;
+    if (runAnalysis(epi, true) != AnalysisComplete) return false;
+    for (size_t i = 0; i < level; ++i) /* every line analyzed should be in one block in each lower level */ {
+        if (i >= analysis.levels.size() || analysis.levels[i].size() != 1) return false;
+        const TabLayoutBlock& tlb = analysis.levels[i][0];
+        if (tlb.firstLine != firstLine || tlb.lastLine != lastLine) return false;
     }
+    layout.splice(firstLine, lastLine, 0, analysis, level);
+    const Scintilla::Line lineCount = sci.LineCount();
+    if (epi.lineTabsSet->size() != lineCount) epi.lineTabsSet->reset(lineCount);
+    else epi.lineTabsSet->clear(firstLine, lastLine);
+    return true;
+}
+
+
+// While background analysis is in progress, analyze only the lines near those visible (or lines firstNeeded through lastNeeded),
+// so that tabstops can be set without waiting for the whole document.  Background analysis replaces this layout when it finishes.
+// The window is widened (by at most another window's worth of lines) to begin and end at lines with no cells, which belong to no
+// tab layout block, so that the widths of blocks near its edges are not computed from only part of the block.
+
+void ColumnsPlusPlusData::analyzeWindow(DocumentData& dd, Scintilla::Line firstNeeded, Scintilla::Line lastNeeded) {
+    ElasticProgressInfo epi(*this, dd);
+    if (!epi.lineTabsSet) return;
+    const Scintilla::Line lineCount    = sci.LineCount();
+    const Scintilla::Line window       = std::max(ElasticProgressInfo::windowLines, Scintilla::Line(elasticPrefetchLines));
+    if (firstNeeded == -1) {
+        const Scintilla::Line firstVisible = sci.FirstVisibleLine();
+        firstNeeded = sci.DocLineFromVisible(firstVisible);
+        lastNeeded  = sci.DocLineFromVisible(firstVisible + sci.LinesOnScreen());
+    }
+    Scintilla::Line first = std::max(firstNeeded - window, Scintilla::Line(0));
+    Scintilla::Line last  = std::min(lastNeeded  + window, lineCount - 1);
+    const DocumentSnapshot text(sci);
+    Scintilla::Position begin;
+    size_t cell;
+    for (const Scintilla::Line limit = std::max(first - window, Scintilla::Line(0));
+         first > limit && epi.scanLine(text, first - 1, begin, cell); --first);
+    for (const Scintilla::Line limit = std::min(last + window, lineCount - 1);
+         last < limit && epi.scanLine(text, last + 1, begin, cell); ++last);
+    dd.windowFirstLine   = first > 0             ? first : std::min(firstNeeded - window, Scintilla::Line(0));
+    dd.windowLastLine    = last  < lineCount - 1 ? last  : std::max(lastNeeded  + window, lineCount - 1);
+    dd.changedFirstLine  = -1;
+    dd.changedLastLine   = -1;
+    dd.changedLinesAdded = 0;
+    epi.lineTabsSet->reset(lineCount);
+    epi.firstNeeded = first;
+    epi.lastNeeded  = last;
+    runAnalysis(epi);
+}
+
+
+// Analysis of a document too large or too slow to analyze at once is done in time slices from a timer, so that editing can
+// continue: dd.backgroundLayout holds the analysis of the lines before dd.backgroundNextLine, and dd.tabLayouts holds an analysis
+// of the lines near those visible, which is repeated when the visible lines move outside it.  Edits before backgroundNextLine
+// move it back (see noteChangedLines); edits after it need nothing more, since those lines have not yet been analyzed.  If
+// backgroundLayout grows past elasticMemoryLimit, background analysis stops and the document is paged: analyzeWindow is repeated
+// for whatever lines are needed, so memory used is bounded by the size of the window rather than the size of the document.
+// Starts background analysis from the current backgroundLayout and backgroundNextLine.
+
+void ColumnsPlusPlusData::startBackgroundAnalysis(DocumentData& dd) {
+    analyzeWindow(dd);
+    if (!elasticBackgroundTimer) elasticBackgroundTimer = SetTimer(0, 0, 10, continueElasticAnalysis);
+}
+
+
+// Continue background analysis of the active document for a short time; returns true if there is more to do.
+// When the whole document has been analyzed, the result replaces the layout made by analyzeWindow.  Before that, the text is
+// hashed, if a stored layout is to be found (then background analysis ends at once if there is one) or the layout is to be stored.
+
+bool ColumnsPlusPlusData::elasticBackgroundStep() {
+    DocumentData* ddp = getDocument(activeScintilla);
+    if (!ddp || !ddp->settings.elasticEnabled) return false;
+    DocumentData& dd = *ddp;
+    if ((dd.layoutCacheFind || dd.layoutCacheStore) && !dd.elasticAnalysisRequired) {
+        if (!hashContent(dd, 20)) return true;
+        if (dd.layoutCacheFind) {
+            dd.layoutCacheFind = false;
+            if (dd.backgroundNextLine >= 0 && !dd.paged && layoutCache.find(layoutCacheKey(dd), dd.backgroundLayout)) {
+                installBackgroundLayout(dd, false);
+                return false;
+            }
+        }
+        if (dd.layoutCacheStore) cacheLayout(dd);
+    }
+    if (dd.backgroundNextLine < 0 || dd.paged) return false;
+    if (dd.elasticAnalysisRequired || fontSpacingChange(dd)) return true;  // wait for scnUpdateUI to start over
+    ElasticProgressInfo epi(*this, dd);
+    if (!epi.lineTabsSet) return false;
+    const Scintilla::Line lineCount = sci.LineCount();
+    epi.analysis    = &dd.backgroundLayout;
+    epi.resume      = true;
     epi.isAnalyze   = true;
-    epi.firstNeeded = 0;
+    epi.firstNeeded = dd.backgroundNextLine;
     epi.lastNeeded  = lineCount - 1;
-    unsigned long long before, after;
-    before = GetTickCount64();
-    double timeLimit = elasticProgressTime;
-    int stepCount = 0;
-    while (epi.analyzeTabstops()) {
-        after = GetTickCount64();
-        ++stepCount;
-        if (after - before < 20) continue;
-        double projected = static_cast<double>(epi.objective() - epi.processed()) * static_cast<double>(after - before)
-                         / (1000 * static_cast<double>(stepCount * epi.stepSize));
-        if (projected > timeLimit) {
-            DialogBoxParam(dllInstance, MAKEINTRESOURCE(IDD_ELASTIC_PROGRESS), nppData._nppHandle, elasticProgressDialogProc, reinterpret_cast<LPARAM>(&epi));
-            break;
+    const auto before = GetTickCount64();
+    bool more;
+    while ((more = epi.analyzeTabstops()) && GetTickCount64() - before < 20);
+    recordThroughput(epi, more ? epi.firstNeeded + epi.step * epi.stepSize : lineCount, before);
+    if (more) {
+        dd.backgroundNextLine = epi.firstNeeded + epi.step * epi.stepSize;
+        if (elasticMemoryLimit > 0 && dd.backgroundLayout.memoryUsed() > (size_t(elasticMemoryLimit) << 20)) {
+            dd.backgroundLayout = TabLayout();  // keep backgroundNextLine, so the document stays in window mode
+            dd.paged = true;
+            return false;
         }
-        before = after;
-        stepCount = 0;
+        return true;
+    }
+    installBackgroundLayout(dd);
+    return dd.layoutCacheStore;
+}
+
+
+// Complete background analysis at once, as when tabstops must be set outside the lines analyzed by analyzeWindow.
+
+void ColumnsPlusPlusData::finishBackgroundAnalysis(DocumentData& dd) {
+    if (dd.elasticAnalysisRequired || fontSpacingChange(dd)) {
+        analyzeTabstops(dd);
+        if (dd.backgroundNextLine < 0) return;
+    }
+    ElasticProgressInfo epi(*this, dd);
+    if (!epi.lineTabsSet) return;
+    epi.analysis    = &dd.backgroundLayout;
+    epi.resume      = true;
+    epi.firstNeeded = dd.backgroundNextLine;
+    epi.lastNeeded  = sci.LineCount() - 1;
+    if (runAnalysis(epi) == AnalysisComplete) {
+        installBackgroundLayout(dd);
+        if (dd.layoutCacheStore && !elasticBackgroundTimer) elasticBackgroundTimer = SetTimer(0, 0, 10, continueElasticAnalysis);
+    }
+    else dd.backgroundNextLine = epi.firstNeeded + epi.step * epi.stepSize;
+}
+
+
+// Replace the layout made by analyzeWindow with the completed background analysis (or a stored layout, which is not stored again
+// if cache is false) and set tabstops for it.
+
+void ColumnsPlusPlusData::installBackgroundLayout(DocumentData& dd, bool cache) {
+    const Scintilla::Line lineCount = sci.LineCount();
+    dd.tabLayouts         = std::move(dd.backgroundLayout);
+    dd.backgroundLayout   = TabLayout();
+    if (cache) cacheLayout(dd);
+    dd.backgroundNextLine = -1;
+    dd.windowFirstLine    = 0;
+    dd.windowLastLine     = -1;
+    dd.changedFirstLine   = -1;
+    dd.changedLastLine    = -1;
+    dd.changedLinesAdded  = 0;
+    dd.tabsSet.reset(lineCount);
+    setTabstops(dd);
+    const HWND active = activeScintilla;
+    if (bothViewsShowSameDocument()) /* the other view may show lines not visible in this one */ {
+        getDocument(active == nppData._scintillaMainHandle ? nppData._scintillaSecondHandle : nppData._scintillaMainHandle);
+        setTabstops(dd);
+        getDocument(active);
     }
 }
 
 
 bool ElasticProgressInfo::analyzeTabstops() {
     auto& sci = data.sci;
-    const Scintilla::Line firstToProcess = step * stepSize;
+    const Scintilla::Line firstToProcess = firstNeeded + step * stepSize;
     const Scintilla::Line lastToProcess  = std::min(lastNeeded, firstToProcess + stepSize - 1);
-    if (!step) dd.tabLayouts.clear();
+    if (!step && !resume) analysis->clear();
+    const DocumentSnapshot text(sci);
     for (Scintilla::Line lineNum = firstToProcess; lineNum <= lastToProcess; ++lineNum) {
-        Scintilla::Position begin = sci.PositionFromLine(lineNum);
-        Scintilla::Position end = sci.LineEnd(lineNum);
-        if (begin == end) continue;
-        std::string lineText = sci.StringOfRange(Scintilla::Span(begin, end));
-        if (dd.settings.treatEolAsTab) lineText += "\t";
-        std::vector<TabLayoutBlock>* layouts = &dd.tabLayouts;
-        size_t from = dd.settings.leadingTabsIndent ? lineText.find_first_not_of('\t') : 0;
-        if (from == std::string::npos) continue;
-        int indentSize = static_cast<int>(from) * tabInd;
-        for (size_t tab; tab = lineText.find_first_of('\t', from), tab != std::string::npos;) {
-            if (!layouts->size() || (!dd.settings.lineUpAll && layouts->back().lastLine < lineNum - 1)) layouts->emplace_back(lineNum, tabMin);
-            TabLayoutBlock& tlb = layouts->back();
+        Scintilla::Position begin;
+        size_t first;
+        if (!scanLine(text, lineNum, begin, first)) continue;
+        size_t parent = TabLayoutBlock::npos;
+        for (size_t cell = first, level = 0; cell < scanner.cells.size(); ++cell, ++level) {
+            if (level >= analysis->levels.size()) analysis->levels.emplace_back();
+            std::vector<TabLayoutBlock>& layouts = analysis->levels[level];
+            if ( layouts.empty() || layouts.back().parent != parent
+              || (!dd.settings.lineUpAll && layouts.back().lastLine < lineNum - 1) ) layouts.emplace_back(lineNum, tabMin, parent);
+            TabLayoutBlock& tlb = layouts.back();
             tlb.lastLine = lineNum;
-            int width = dd.assumeMonospace ? static_cast<int>((sci.CountCharacters(begin + from, begin + tab) * ch1440 + 720)/1440)
-                                           : data.unwrappedWidth(begin + from, begin + tab);
-            width += tabGap + indentSize;
-            indentSize = 0;
+            const int width = layoutWidth(begin, first, cell);
             if (width > tlb.width) tlb.width = width;
-            from = tab + 1;
-            layouts = &tlb.right;
+            tlb.cells.add(width);
+            parent = layouts.size() - 1;
         }
     }
     if (lastToProcess < lastNeeded) {
@@ -364,6 +954,153 @@ bool ElasticProgressInfo::analyzeTabstops() {
 }
 
 
+// Find the cells in a line, setting begin to the position of the line and first to the index in scanner.cells of the first cell
+// after any leading tabs.  Fetches the styled text of the line for proportional fonts.  Returns false if there are no such cells.
+
+bool ElasticProgressInfo::scanLine(const DocumentSnapshot& text, Scintilla::Line lineNum, Scintilla::Position& begin, size_t& first) {
+    auto& sci = data.sci;
+    begin = sci.PositionFromLine(lineNum);
+    const Scintilla::Position end = sci.LineEnd(lineNum);
+    if (begin == end) return false;
+    scanner.scan(text, begin, end, dd.settings.treatEolAsTab);
+    const std::vector<TabScanner::Cell>& cells = scanner.cells;
+    if (!dd.assumeMonospace) {
+        styledLine.resize(2 * (end - begin) + 2);
+        Scintilla::TextRangeFull tr { { begin, end }, styledLine.data() };
+        sci.GetStyledTextFull(&tr);
+    }
+    first = 0;
+    if (dd.settings.leadingTabsIndent) while (first < cells.size() && cells[first].end == first) ++first;
+    return first < cells.size();
+}
+
+
+// Returns the width a cell found by scanLine contributes to its tab layout block, including the space between columns and,
+// for the first cell, the indent due to leading tabs.
+
+int ElasticProgressInfo::layoutWidth(Scintilla::Position begin, size_t first, size_t cell) {
+    const size_t from = scanner.cells[cell].start;
+    const size_t tab  = scanner.cells[cell].end;
+    const int width = !dd.assumeMonospace ? cellWidth(begin, from, tab)
+                    : static_cast<int>(((scannerCounts ? scanner.cells[cell].characters
+                                                       : data.sci.CountCharacters(begin + from, begin + tab)) * ch1440 + 720)/1440);
+    return width + tabGap + (cell == first ? static_cast<int>(first) * tabInd : 0);
+}
+
+
+// Returns the width the cell at the given level in a line contributes to its tab layout block, or -1 if there is no such cell.
+
+int ElasticProgressInfo::cellWidthAt(Scintilla::Line lineNum, size_t level) {
+    Scintilla::Position begin;
+    size_t first;
+    if (!scanLine(DocumentSnapshot(data.sci), lineNum, begin, first) || first + level >= scanner.cells.size()) return -1;
+    return layoutWidth(begin, first, first + level);
+}
+
+
+// Measure the text in the line beginning at lineStart from offset from to offset to, using the width cache when possible.
+// styledLine must hold the styled text for the line.
+
+int ElasticProgressInfo::cellWidth(Scintilla::Position lineStart, size_t from, size_t to) {
+    TextWidthCache& cache = dd.widthCache;
+    bool ascii = asciiAdvances;
+    for (size_t i = from; ascii && i < to; ++i) if (styledLine[2 * i] < 0x20 || styledLine[2 * i] > 0x7E) ascii = false;
+    if (ascii) {
+        int width = 0;
+        for (size_t i = from; i < to; ++i) {
+            const unsigned char style = styledLine[2 * i + 1];
+            std::vector<int>& advance = cache.advances[style];
+            if (advance.empty()) for (char c = 0x20; c <= 0x7E; ++c) advance.push_back(data.sci.TextWidth(style, std::string(1, c).data()));
+            width += advance[styledLine[2 * i] - 0x20];
+        }
+        ++cache.asciiHits;
+        return width;
+    }
+    std::string key;  // style runs as a style byte followed by the run length in 7-bit groups, then the text
+    for (size_t i = from; i < to;) {
+        const char style = styledLine[2 * i + 1];
+        size_t next = i + 1;
+        while (next < to && styledLine[2 * next + 1] == style) ++next;
+        key += style;
+        for (size_t n = next - i;; n >>= 7) {
+            if (n < 0x80) {
+                key += static_cast<char>(n);
+                break;
+            }
+            key += static_cast<char>(0x80 | (n & 0x7F));
+        }
+        i = next;
+    }
+    for (size_t i = from; i < to; ++i) key += styledLine[2 * i];
+    if (auto found = cache.widths.find(key); found != cache.widths.end()) {
+        ++cache.hits;
+        return found->second;
+    }
+    ++cache.misses;
+    const int width = data.unwrappedWidth(lineStart + from, lineStart + to);
+    cache.add(std::move(key), width);
+    return width;
+}
+
+
+// Returns the width of the text from one position to another in the same line as it would be if the line were not wrapped.
+// The wrap points are found by binary search on the y coordinates of positions, and kept in wrapBreaks for the next call,
+// since the cells of a line are usually measured one after another from left to right.
+
+int ColumnsPlusPlusData::unwrappedWidth(Scintilla::Position from, Scintilla::Position to) {
+    int xLoc = sci.PointXFromPosition(from);
+    const int xEnd = sci.PointXFromPosition(to);
+    if (sci.WrapMode() == Scintilla::Wrap::None) return xEnd - xLoc;
+    const Scintilla::Line line = sci.LineFromPosition(from);
+    if (sci.WrapCount(line) < 2) return xEnd - xLoc;
+    WrapBreakCache& cache = wrapBreaks;
+    const Scintilla::Position lineStart = sci.PositionFromLine(line);
+    const Scintilla::Position lineEnd   = sci.LineEnd(line);
+    const int lineEndX = sci.PointXFromPosition(lineEnd);
+    void* const document = sci.DocPointer();
+    if ( cache.line != line || cache.document != document || cache.lineStart != lineStart
+      || cache.lineEnd != lineEnd || cache.lineEndX != lineEndX ) {
+        cache.clear();
+        cache.document  = document;
+        cache.line      = line;
+        cache.lineStart = lineStart;
+        cache.lineEnd   = lineEnd;
+        cache.lineEndX  = lineEndX;
+        cache.searched  = lineStart;
+    }
+    if (to > cache.searched) /* find the wrap points after those already known, up to to */ {
+        Scintilla::Position low = cache.searched;
+        int yLow = sci.PointYFromPosition(low);
+        const int yTo = sci.PointYFromPosition(to);
+        while (yLow != yTo) {
+            Scintilla::Position high = to;  // the first position on a later sub-line is in (low, high]
+            for (;;) {
+                const Scintilla::Position after = sci.PositionAfter(low);
+                if (after >= high) break;
+                Scintilla::Position middle = sci.PositionBefore(sci.PositionAfter(low + (high - low) / 2));
+                if (middle <= low) middle = after;
+                if (sci.PointYFromPosition(middle) == yLow) low = middle;
+                else high = middle;
+            }
+            const Scintilla::Position last = sci.PositionBefore(high);
+            std::string lastCharacter = sci.StringOfRange(Scintilla::Span(last, high));
+            if (lastCharacter.empty() || !lastCharacter[0]) lastCharacter = " ";
+            cache.breaks.push_back({ high, sci.PointXFromPosition(last) + sci.TextWidth(sci.StyleIndexAt(last), lastCharacter.data()),
+                                     sci.PointXFromPosition(high) });
+            low  = high;
+            yLow = sci.PointYFromPosition(high);
+        }
+        cache.searched = to;
+    }
+    int width = 0;
+    for (const WrapBreakCache::Break& wrap : cache.breaks) if (wrap.position > from && wrap.position <= to) {
+        width += wrap.endX - xLoc;
+        xLoc   = wrap.startX;
+    }
+    return width + xEnd - xLoc;
+}
+
+
 // Given a Scintilla position and length, find the tab layout block within which the characters occur.
 // If found, true is returned and tlb points to the tab layout block and width is the pixel width of the text in the block on the line containing the characters.
 // If the characters occur after the last tab on a line and treatEolAsTab is not set, true is returned and tlb is null.
@@ -372,7 +1109,8 @@ bool ElasticProgressInfo::analyzeTabstops() {
 // adding or removing the characters would change which tabs are leading tabs and leadingTabsIndent is true,
 // or an error has occurred, false is returned.  False implies the tab layout cannot be updated and a new full analysis is required.
 
-bool ColumnsPlusPlusData::findTabLayoutBlock(DocumentData& dd, Scintilla::Position position, Scintilla::Position length, TabLayoutBlock*& tlb, int& width) {
+bool ColumnsPlusPlusData::findTabLayoutBlock(DocumentData& dd, Scintilla::Position position, Scintilla::Position length, TabLayoutBlock*& tlb, int& width,
+                                             size_t* level) {
     Scintilla::Line lineNum = sci.LineFromPosition(position);
     Scintilla::Position endLine = sci.LineEnd(lineNum);
     if (position + length > endLine) /* string goes past end of line */ {
@@ -423,20 +1161,50 @@ bool ColumnsPlusPlusData::findTabLayoutBlock(DocumentData& dd, Scintilla::Positi
         tabStopBefore = p;
     }
     width = sci.PointXFromPosition(beginLine + (tabAfter - line)) - sci.PointXFromPosition(beginLine + (tabStopBefore - line));
-    std::vector<TabLayoutBlock>* layouts = &dd.tabLayouts;
-    for (int n = 0; n <= tabCount; ++n) {
-        for (size_t i = 0;; ++i) /* find TabLayoutBlock at level n for line lineNum */ {
-            if (i >= layouts->size()) /* no such TabLayoutBlock */ {
-                tlb = 0;
-                width = -999;
-                return false;
-            }
-            tlb = &(*layouts)[i];
-            if (lineNum >= tlb->firstLine && lineNum <= tlb->lastLine) {
-                layouts = &tlb->right;
-                break;
-            }
-        }
+    tlb = dd.tabLayouts.find(lineNum, tabCount);
+    if (!tlb) /* no such TabLayoutBlock */ {
+        width = -999;
+        return false;
+    }
+    if (level) *level = tabCount;
+    return true;
+}
+
+
+// Before text is inserted or deleted within one cell, record the width the cell contributes to its tab layout block.
+
+void ColumnsPlusPlusData::beginCellChange(DocumentData& dd, Scintilla::Position position, Scintilla::Position length, size_t level) {
+    ElasticProgressInfo epi(*this, dd);
+    dd.cellChangeLine     = sci.LineFromPosition(position);
+    dd.cellChangeLevel    = level;
+    dd.cellChangeWidth    = epi.cellWidthAt(dd.cellChangeLine, level);
+    dd.cellChangePosition = position;
+    dd.cellChangeLength   = length;
+    dd.cellChangePending  = dd.cellChangeWidth >= 0;
+}
+
+
+// After a change recorded by beginCellChange, replace the old width of the cell with the new one in the cell widths of its tab
+// layout block and set the block width from them; the block's lines are marked for new tabstops if the width changed.  This lets
+// the block narrow when its widest cell is shortened without analyzing the block again.  Returns false if the change does not
+// match, or the new block width cannot be determined; the lines must then be analyzed.
+
+bool ColumnsPlusPlusData::endCellChange(DocumentData& dd, Scintilla::Position position, Scintilla::Position length) {
+    if (!dd.cellChangePending) return false;
+    dd.cellChangePending = false;
+    if (position != dd.cellChangePosition || length != dd.cellChangeLength) return false;
+    TabLayoutBlock* tlb = dd.tabLayouts.find(dd.cellChangeLine, dd.cellChangeLevel);
+    if (!tlb) return false;
+    ElasticProgressInfo epi(*this, dd);
+    const int newWidth = epi.cellWidthAt(dd.cellChangeLine, dd.cellChangeLevel);
+    if (newWidth < 0 || !tlb->cells.remove(dd.cellChangeWidth)) return false;
+    tlb->cells.add(newWidth);
+    const int widest = tlb->cells.maximum();
+    if (widest < 0) return false;
+    const int width = std::max(epi.tabMin, widest);
+    if (width != tlb->width) {
+        tlb->width = width;
+        dd.tabsSet.clear(tlb->firstLine, tlb->lastLine);
     }
     return true;
 }
@@ -445,28 +1213,47 @@ bool ColumnsPlusPlusData::findTabLayoutBlock(DocumentData& dd, Scintilla::Positi
 void ColumnsPlusPlusData::scnModified(const Scintilla::NotificationData* scnp) {
     using Scintilla::FlagSet;
     if ( !FlagSet( scnp->modificationType,
-                   ( Scintilla::ModificationFlags::InsertText | Scintilla::ModificationFlags::BeforeDelete
-                   | Scintilla::ModificationFlags::DeleteText | Scintilla::ModificationFlags::ChangeStyle ) ) ) return;
+                   ( Scintilla::ModificationFlags::InsertText | Scintilla::ModificationFlags::BeforeInsert
+                   | Scintilla::ModificationFlags::BeforeDelete | Scintilla::ModificationFlags::DeleteText
+                   | Scintilla::ModificationFlags::ChangeStyle ) ) ) return;
+    // Wrap points are kept for one line; discard them if the change touches it, or renumbers it by adding or removing lines.
+    wrapBreaks.clear(sci.DocPointer(), sci.LineFromPosition(scnp->position),
+                     scnp->linesAdded ? sci.LineCount() : sci.LineFromPosition(scnp->position + scnp->length));
     DocumentData* ddp = getDocument(scnp);
     if (!ddp) return;
     DocumentData& ctd = *ddp;
-    if (!ctd.settings.elasticEnabled || ctd.elasticAnalysisRequired) return;
+    if (!FlagSet(scnp->modificationType, Scintilla::ModificationFlags::ChangeStyle)) {
+        if (scnp->position < ctd.contentHashed) ctd.contentHashed = 0;  // changes after the text hashed so far can be ignored
+        ctd.layoutCacheStore = false;
+    }
+    if (!ctd.settings.elasticEnabled || ctd.elasticAnalysisRequired) {
+        if (scnp->linesAdded) ctd.tabstopsApplied.clear();
+        return;
+    }
+    if (ctd.pasteFirstLine >= 0 && trackPaste(ctd, scnp)) return;
+    const bool changesPending = ctd.changedFirstLine >= 0  /* tabLayouts may not match current line numbers */
+                             || ctd.backgroundNextLine > sci.LineFromPosition(scnp->position);  /* background analysis must restart */
+    if (FlagSet(scnp->modificationType, Scintilla::ModificationFlags::BeforeInsert)) {
+        ctd.cellChangePending = false;
+        TabLayoutBlock* tlb;
+        int width;
+        size_t level;
+        if (!changesPending && findTabLayoutBlock(ctd, scnp->position, 0, tlb, width, &level) && tlb)
+            beginCellChange(ctd, scnp->position, scnp->length, level);
+        return;
+    }
     if (FlagSet(scnp->modificationType, Scintilla::ModificationFlags::InsertText)) {
         ctd.deleteWithoutLayoutChange = false;
-        if (scnp->linesAdded == 0) /* Unless the number of lines is unchanged, we need full analysis. */ {
+        if (scnp->linesAdded == 0 && !changesPending) /* Unless the number of lines is unchanged, we need full analysis. */ {
             TabLayoutBlock* tlb;
             int width;
             if (findTabLayoutBlock(ctd, scnp->position, scnp->length, tlb, width)) {
-                if (tlb) {
+                if (tlb && !endCellChange(ctd, scnp->position, scnp->length)) {
+                    tlb->cells.exact = false;
                     width += sci.TextWidth(STYLE_DEFAULT, std::string(ctd.settings.minimumSpaceBetweenColumns, ' ').data());
                     if (width > tlb->width) {
                         tlb->width = width;
-                        auto lineTabsSet = getLineTabsSet();
-                        if (lineTabsSet) {
-                            if (bothViewsShowSameDocument())
-                                 for (Scintilla::Line ln = tlb->firstLine; ln <= tlb->lastLine; ++ln) view1TabsSet[ln] = view2TabsSet[ln] = 0;
-                            else for (Scintilla::Line ln = tlb->firstLine; ln <= tlb->lastLine; ++ln) (*lineTabsSet)[ln] = 0;
-                        }
+                        ctd.tabsSet.clear(tlb->firstLine, tlb->lastLine);
                     }
                 }
                 return;
@@ -474,9 +1261,12 @@ void ColumnsPlusPlusData::scnModified(const Scintilla::NotificationData* scnp) {
         }
     }
     else if (FlagSet(scnp->modificationType, Scintilla::ModificationFlags::BeforeDelete)) {
+        ctd.cellChangePending = false;
         TabLayoutBlock* tlb;
         int width;
-        if (findTabLayoutBlock(ctd, scnp->position, scnp->length, tlb, width)) {
+        size_t level;
+        if (!changesPending && findTabLayoutBlock(ctd, scnp->position, scnp->length, tlb, width, &level)) {
+            if (tlb) beginCellChange(ctd, scnp->position, scnp->length, level);
             width += sci.TextWidth(STYLE_DEFAULT, std::string(ctd.settings.minimumSpaceBetweenColumns, ' ').data());
             if (!tlb || width < tlb->width - 1) /* a one-pixel error is possible with DirectWrite and monospace font optimization */ {
                 ctd.deleteWithoutLayoutChange         = true;
@@ -491,10 +1281,19 @@ void ColumnsPlusPlusData::scnModified(const Scintilla::NotificationData* scnp) {
     else if (FlagSet(scnp->modificationType, Scintilla::ModificationFlags::DeleteText)) {
         if (ctd.deleteWithoutLayoutChange && scnp->position == ctd.deleteWithoutLayoutChangePosition && scnp->length == ctd.deleteWithoutLayoutChangeLength) {
             ctd.deleteWithoutLayoutChange = false;
+            if (ctd.cellChangePending && !endCellChange(ctd, scnp->position, scnp->length)) {
+                TabLayoutBlock* tlb = ctd.tabLayouts.find(ctd.cellChangeLine, ctd.cellChangeLevel);
+                if (tlb) tlb->cells.exact = false;
+            }
             return;
         }
+        if (!changesPending && endCellChange(ctd, scnp->position, scnp->length)) return;  /* the widest cell was shortened */
     }
-    ctd.elasticAnalysisRequired = true;
+    Scintilla::Line firstChanged = sci.LineFromPosition(scnp->position);
+    Scintilla::Line lastChanged  = FlagSet(scnp->modificationType, Scintilla::ModificationFlags::ChangeStyle)
+                                 ? sci.LineFromPosition(scnp->position + scnp->length)
+                                 : firstChanged + std::max(scnp->linesAdded, Scintilla::Line(0));
+    noteChangedLines(ctd, firstChanged, lastChanged, scnp->linesAdded);
 }
 
 
@@ -505,8 +1304,15 @@ void ColumnsPlusPlusData::scnUpdateUI(const Scintilla::NotificationData* scnp) {
     if (Scintilla::FlagSet(scnp->updated, Scintilla::Update::Selection)) syncFindButton();
     if (!ddp->settings.elasticEnabled) return;
     ddp->deleteWithoutLayoutChange = false;
-    const bool fullAnalysis = (ddp->elasticAnalysisRequired || fontSpacingChange(*ddp));
-    if (fullAnalysis) analyzeTabstops(*ddp);
+    bool layoutChanged = (ddp->elasticAnalysisRequired || fontSpacingChange(*ddp));
+    if (layoutChanged) analyzeTabstops(*ddp);
+    else if ( ddp->backgroundNextLine >= 0
+           && ( sci.DocLineFromVisible(sci.FirstVisibleLine()) < ddp->windowFirstLine
+             || sci.DocLineFromVisible(sci.FirstVisibleLine() + sci.LinesOnScreen()) > ddp->windowLastLine ) ) {
+        analyzeWindow(*ddp);
+        layoutChanged = true;
+    }
+    else layoutChanged = analyzeChangedLines(*ddp);
     if (!selectionMouseUpTimerActive && Scintilla::FlagSet(scnp->updated, Scintilla::Update::Selection)) {
         Scintilla::SelectionMode selectionMode = sci.SelectionMode();
         if (selectionMode == Scintilla::SelectionMode::Rectangle || selectionMode == Scintilla::SelectionMode::Thin) {
@@ -517,7 +1323,7 @@ void ColumnsPlusPlusData::scnUpdateUI(const Scintilla::NotificationData* scnp) {
             else reselectRectangularSelection(*ddp);
         }
     }
-    setTabstops(*ddp, -1, -1, !fullAnalysis);
+    setTabstops(*ddp, -1, -1, !layoutChanged);
 }
 
 
@@ -549,11 +1355,89 @@ void ColumnsPlusPlusData::beforePaste() {
             DocumentData& dd = *getDocument();
             Scintilla::Line currentLine = sci.LineFromPosition(sci.CurrentPos());
             setTabstops(dd, currentLine, currentLine + depth);
+            if ( clipboardString.find(L'\t') != std::wstring::npos && !dd.tabLayouts.empty() && !dd.settings.lineUpAll
+              && dd.changedLinesAdded == 0 && dd.backgroundNextLine < 0 ) /* track the paste so afterPaste can update the layout */ {
+                dd.pasteFirstLine    = currentLine;
+                dd.pasteLastLine     = currentLine + depth;
+                dd.pasteChangedFirst = -1;
+                dd.pasteChangedLast  = -1;
+            }
         }
     }
 }
 
 
+// Called from scnModified while a rectangular paste is tracked.  Insertions within the lines expected, which add no lines and
+// are made after at least one tab (not counting leading tabs when leadingTabsIndent is set), are collected for afterPaste;
+// returns true if the notification was handled that way.  Any other insertion or deletion ends tracking; changes of style are
+// left to scnModified without ending tracking, since they do not change line numbering.
+
+bool ColumnsPlusPlusData::trackPaste(DocumentData& dd, const Scintilla::NotificationData* scnp) {
+    using Scintilla::FlagSet;
+    if (FlagSet(scnp->modificationType, Scintilla::ModificationFlags::ChangeStyle)) return false;
+    const Scintilla::Line line = sci.LineFromPosition(scnp->position);
+    if (scnp->linesAdded || line < dd.pasteFirstLine || line > dd.pasteLastLine || dd.changedLinesAdded || dd.backgroundNextLine >= 0
+      || FlagSet(scnp->modificationType, Scintilla::ModificationFlags::BeforeDelete | Scintilla::ModificationFlags::DeleteText)) {
+        endPasteTracking(dd);
+        return false;
+    }
+    if (FlagSet(scnp->modificationType, Scintilla::ModificationFlags::BeforeInsert)) {
+        dd.cellChangePending = false;
+        return true;
+    }
+    const Scintilla::Position begin = sci.PositionFromLine(line);
+    const std::string before = sci.StringOfRange(Scintilla::Span(begin, scnp->position));
+    size_t i = 0;
+    if (dd.settings.leadingTabsIndent) while (i < before.length() && before[i] == '\t') ++i;
+    const size_t level = std::count(before.begin() + i, before.end(), '\t');
+    if (!level) {
+        endPasteTracking(dd);
+        return false;
+    }
+    if (dd.pasteChangedFirst < 0) {
+        dd.pasteChangedFirst = dd.pasteChangedLast = line;
+        dd.pasteLevel = level;
+    }
+    else {
+        dd.pasteChangedFirst = std::min(dd.pasteChangedFirst, line);
+        dd.pasteChangedLast  = std::max(dd.pasteChangedLast , line);
+        dd.pasteLevel        = std::min(dd.pasteLevel, level);
+    }
+    dd.deleteWithoutLayoutChange = false;
+    return true;
+}
+
+
+// Stop tracking a paste, passing any changes collected so far to noteChangedLines.
+
+void ColumnsPlusPlusData::endPasteTracking(DocumentData& dd) {
+    if (dd.pasteChangedFirst >= 0) noteChangedLines(dd, dd.pasteChangedFirst, dd.pasteChangedLast, 0);
+    dd.pasteFirstLine    = -1;
+    dd.pasteLastLine     = -1;
+    dd.pasteChangedFirst = -1;
+    dd.pasteChangedLast  = -1;
+}
+
+
+// After a paste tracked by beforePaste, update the layout for the lines changed without analyzing whole top-level blocks.
+
+void ColumnsPlusPlusData::afterPaste() {
+    DocumentData* ddp = getDocument();
+    if (!ddp || ddp->pasteFirstLine < 0) return;
+    DocumentData& dd = *ddp;
+    const Scintilla::Line firstChanged = dd.pasteChangedFirst;
+    const Scintilla::Line lastChanged  = dd.pasteChangedLast;
+    dd.pasteChangedFirst = -1;
+    endPasteTracking(dd);
+    if (firstChanged < 0 || !dd.settings.elasticEnabled) return;
+    if (!analyzePastedLines(dd, firstChanged, lastChanged, dd.pasteLevel)) {
+        noteChangedLines(dd, firstChanged, lastChanged, 0);
+        return;
+    }
+    setTabstops(dd);
+}
+
+
 void ColumnsPlusPlusData::scnZoom(const Scintilla::NotificationData* scnp) {
     DocumentData* ddp = getDocument(scnp);
     if (!ddp || !ddp->settings.elasticEnabled) return;
@@ -581,18 +1465,25 @@ void ColumnsPlusPlusData::bufferActivated() {
             static_cast<ElasticTabsProfile&>(settings) = profiles[profileName];
             settings.elasticEnabled = true;
         }
-        if ( extension.length() && settings.elasticEnabled
-          && ( disableOverSize > 0 && disableOverSize * 1024 < sci.Length()
-            || disableOverLines > 0 && disableOverLines < sci.LineCount() ) )
-            settings.elasticEnabled = false;
+        dd.streaming = false;
+        if (extension.length() && settings.elasticEnabled && exceedsElasticLimits()) {
+            if (elasticStreaming) dd.streaming = true;
+                             else settings.elasticEnabled = false;
+        }
         dd.settings = settings;
         if (settings.elasticEnabled && !sentADDSCNMODIFIEDFLAGS) {
             sentADDSCNMODIFIEDFLAGS = true;
             SendMessage(nppData._nppHandle, NPPM_ADDSCNMODIFIEDFLAGS, 0,
-                SC_MOD_INSERTTEXT | SC_MOD_BEFOREDELETE | SC_MOD_DELETETEXT | SC_MOD_CHANGESTYLE);
+                SC_MOD_INSERTTEXT | SC_MOD_BEFOREINSERT | SC_MOD_BEFOREDELETE | SC_MOD_DELETETEXT | SC_MOD_CHANGESTYLE);
         }
     }
     else settings = dd.settings;
+    dd.lastActive = ++activations;
+    trimDocuments();
+    if (rectangularTarget) /* a whole column target belongs to the document in which it was chosen */ {
+        rectangularTarget.reset();
+        SendMessage(nppData._nppHandle, NPPM_SETMENUITEMCHECK, wholeColumnMenuItem, FALSE);
+    }
     SendMessage(nppData._nppHandle, NPPM_SETMENUITEMCHECK, elasticEnabledMenuItem, settings.elasticEnabled);
     SendMessage(nppData._nppHandle, NPPM_SETMENUITEMCHECK, decimalSeparatorMenuItem, settings.decimalSeparatorIsComma);
     dd.tabOriginal = sci.TabWidth();
@@ -602,27 +1493,83 @@ void ColumnsPlusPlusData::bufferActivated() {
         return;
     }
     if (settings.overrideTabSize) sci.SetTabWidth(settings.minimumOrLeadingTabSize);
-    if (isNewDocument) {
+    if (isNewDocument || dd.elasticAnalysisRequired /* changed while hidden, or layout discarded by trimDocuments */) {
         analyzeTabstops(dd);
         setTabstops(dd);
     }
     else {
         int ccsym = settings.monospaceNoMnemonics && dd.assumeMonospace ? '!' : 0;
         if (sci.ControlCharSymbol() != ccsym) sci.SetControlCharSymbol(ccsym);
+        if (((dd.backgroundNextLine >= 0 && !dd.paged) || dd.layoutCacheFind || dd.layoutCacheStore) && !elasticBackgroundTimer)
+            elasticBackgroundTimer = SetTimer(0, 0, 10, continueElasticAnalysis);
         if (dd.tabLayouts.empty()) return;
-        auto lineTabsSet = getLineTabsSet();
+        auto lineTabsSet = getLineTabsSet(dd);
         if (!lineTabsSet) return;
         Scintilla::Line lines = sci.LineCount();
         for (Scintilla::Line i = 0; i < lines; ++i) {
             int tab = sci.GetNextTabStop(i, 0);
             if (tab != 0) return;
         }
-        lineTabsSet->assign(lines, 0);
+        lineTabsSet->reset(lines);
+        dd.tabstopsApplied.clear();
         reselectRectangularSelection(dd);
     }
 }
 
 
+size_t ColumnsPlusPlusData::documentMemoryUsed() const {
+    size_t bytes = 0;
+    for (const auto& [docptr, dd] : documents) bytes += dd.memoryUsed();
+    return bytes;
+}
+
+
+// Keep the memory used for elastic tabstop data of documents not shown in either view within elasticMemoryLimit by discarding the
+// data for those least recently shown.  The documents now shown are not counted, so that when they alone exceed the limit the
+// hidden documents are not all discarded on every activation.  A document whose data was discarded is analyzed again when it is
+// activated; large documents will usually be found in the layout cache.
+
+void ColumnsPlusPlusData::trimDocuments() {
+    if (elasticMemoryLimit <= 0) return;
+    const size_t limit = static_cast<size_t>(elasticMemoryLimit) << 20;
+    std::vector<UINT_PTR> shown;
+    for (int view = 0; view < 2; ++view) {
+        const intptr_t index = SendMessage(nppData._nppHandle, NPPM_GETCURRENTDOCINDEX, 0, view);
+        if (index >= 0) shown.push_back(SendMessage(nppData._nppHandle, NPPM_GETBUFFERIDFROMPOS, index, view));
+    }
+    std::vector<DocumentData*> candidates;
+    size_t used = 0;
+    for (auto& [docptr, dd] : documents) if (std::find(shown.begin(), shown.end(), dd.buffer) == shown.end()) {
+        const size_t bytes = dd.memoryUsed();
+        if (!bytes) continue;
+        candidates.push_back(&dd);
+        used += bytes;
+    }
+    if (used <= limit) return;
+    std::sort(candidates.begin(), candidates.end(), [](const DocumentData* a, const DocumentData* b) { return a->lastActive < b->lastActive; });
+    for (DocumentData* ddp : candidates) {
+        if (used <= limit) break;
+        DocumentData& dd = *ddp;
+        used -= dd.memoryUsed();
+        dd.tabLayouts         = TabLayout();
+        dd.backgroundLayout   = TabLayout();
+        dd.paged              = false;
+        dd.widthCache         = TextWidthCache();
+        dd.tabsSet            = LineRuns();
+        dd.tabstopsApplied    = AppliedTabstops();
+        dd.backgroundNextLine = -1;
+        dd.windowFirstLine    = 0;
+        dd.windowLastLine     = -1;
+        dd.changedFirstLine   = -1;
+        dd.changedLastLine    = -1;
+        dd.changedLinesAdded  = 0;
+        dd.cellChangePending         = false;
+        dd.deleteWithoutLayoutChange = false;
+        if (dd.settings.elasticEnabled) dd.elasticAnalysisRequired = true;
+    }
+}
+
+
 void ColumnsPlusPlusData::fileClosed(const NMHDR* nmhdr) {
     // If the file (buffer) is closed in one view but remains open in the other, or is moved from one view to the other,
     // we still get this notification. So we have to check to see if the buffer is still open in either view.
@@ -649,7 +1596,9 @@ void ColumnsPlusPlusData::modifyAll(const NMHDR* nmhdr) {
     bool visible2 = cdi2 < 0 ? false : bufferID == static_cast<UINT_PTR>(SendMessage(nppData._nppHandle, NPPM_GETBUFFERIDFROMPOS, cdi2, 1));
     if (visible1 || visible2) {
         DocumentData* ddp = getDocument(visible1 ? nppData._scintillaMainHandle : nppData._scintillaSecondHandle);
-        if (!ddp || !ddp->settings.elasticEnabled) return;
+        if (!ddp) return;
+        ddp->tabstopsApplied.clear();  // lines may have moved without notifications
+        if (!ddp->settings.elasticEnabled) return;
         analyzeTabstops(*ddp);
         setTabstops(*ddp);
         if (visible1 && visible2) {
@@ -661,6 +1610,7 @@ void ColumnsPlusPlusData::modifyAll(const NMHDR* nmhdr) {
     }
     else for (auto i = documents.begin(); i != documents.end(); ++i) if (i->second.buffer == bufferID) {
         DocumentData& dd = i->second;
+        dd.tabstopsApplied.clear();
         if (dd.settings.elasticEnabled) dd.elasticAnalysisRequired = true;
         break;
     }
@@ -683,7 +1633,7 @@ void ColumnsPlusPlusData::toggleElasticEnabled() {
         if (!sentADDSCNMODIFIEDFLAGS) {
             sentADDSCNMODIFIEDFLAGS = true;
             SendMessage(nppData._nppHandle, NPPM_ADDSCNMODIFIEDFLAGS, 0,
-                SC_MOD_INSERTTEXT | SC_MOD_BEFOREDELETE | SC_MOD_DELETETEXT | SC_MOD_CHANGESTYLE);
+                SC_MOD_INSERTTEXT | SC_MOD_BEFOREINSERT | SC_MOD_BEFOREDELETE | SC_MOD_DELETETEXT | SC_MOD_CHANGESTYLE);
         }
     } 
     else {
@@ -692,6 +1642,7 @@ void ColumnsPlusPlusData::toggleElasticEnabled() {
         if (sci.ControlCharSymbol()) sci.SetControlCharSymbol(0);
         Scintilla::Line lineCount = sci.LineCount();
         for (Scintilla::Line lineNum = 0; lineNum < lineCount; ++lineNum) sci.ClearTabStops(lineNum);
+        ddp->tabstopsApplied.clear();
     }
     if (bothViewsShowSameDocument()) {
         activeScintilla = activeScintilla == nppData._scintillaMainHandle ? nppData._scintillaSecondHandle : nppData._scintillaMainHandle;
@@ -708,6 +1659,7 @@ void ColumnsPlusPlusData::toggleElasticEnabled() {
             if (sci.ControlCharSymbol()) sci.SetControlCharSymbol(0);
             Scintilla::Line lineCount = sci.LineCount();
             for (Scintilla::Line lineNum = 0; lineNum < lineCount; ++lineNum) sci.ClearTabStops(lineNum);
+            ddp->tabstopsApplied.clear();
         }
     }
 }
@@ -18,9 +18,12 @@
 
 #include "WindowsScintillaCommon.h"
 
+#include <array>
 #include <charconv>
 #include <map>
 #include <memory>
+#include <optional>
+#include <unordered_map>
 
 namespace NPP {
     #include "Host\PluginInterface.h"
@@ -77,6 +80,8 @@ public:
     int  customColor           = 0x007898;  // color for custom indicator
     int  customIndicator       = 18;        // custom indicator number
     int  userIndicator         = 18;        // user-specified custom indicator number
+    int  countThreads          = 0;         // worker threads for regular expression Count; 0 = one for each processor, 1 = none
+    int  countChunkSize        = 1024;      // kilobytes of text in each piece of work given to a Count worker thread
 };
 
 class SearchData : public SearchSettings {
@@ -206,14 +211,243 @@ public:
 };
 
 
+class CellWidths {
+public:
+    // The largest distinct widths of the cells in a tab layout block, with the number of cells having each, so that the width
+    // of the block can be found again without re-analysis when one of its widest cells becomes narrower.
+    static constexpr int size = 3;
+    int  width[size] = {};      // in descending order
+    int  count[size] = {};      // zero for unused entries, which follow the used ones
+    bool partial = false;       // some cells are narrower than all the widths listed and are not counted
+    bool exact   = true;        // false if the widths are not known, as when the block width was changed other than by analysis
+    void add   (int w);
+    bool remove(int w);         // returns false, and clears exact, if w is not the width of a cell counted
+    void merge (const CellWidths& other);
+    int  maximum() const { return !exact ? -1 : count[0] ? width[0] : partial ? -1 : 0; }  // -1 if not known
+};
+
 class TabLayoutBlock {
 public:
     Scintilla::Line firstLine, lastLine;
-    int width;
-    std::vector<TabLayoutBlock> right;
-    TabLayoutBlock(Scintilla::Line line, int width = 0) : firstLine(line), lastLine(line), width(width) {}
+    int    width;
+    size_t parent;    // index of the enclosing block in the previous level, or npos for level zero
+    CellWidths cells;
+    static constexpr size_t npos = static_cast<size_t>(-1);
+    TabLayoutBlock(Scintilla::Line line, int width = 0, size_t parent = npos) : firstLine(line), lastLine(line), width(width), parent(parent) {}
+};
+
+class TabLayout {
+public:
+
+    // levels[n] holds the blocks for the nth tab (not counting leading tabs when leadingTabsIndent is set) on each line, sorted by line.
+    // Blocks in a level never overlap, and each block lies within its parent block in the previous level.
+
+    std::vector<std::vector<TabLayoutBlock>> levels;
+
+    void clear() { for (auto& level : levels) level.clear(); }  // keeps the allocated storage for reuse
+    bool empty() const { return levels.empty() || levels[0].empty(); }
+
+    size_t memoryUsed() const {
+        size_t bytes = levels.capacity() * sizeof(std::vector<TabLayoutBlock>);
+        for (const auto& level : levels) bytes += level.capacity() * sizeof(TabLayoutBlock);
+        return bytes;
+    }
+
+    size_t lowerBound(size_t level, Scintilla::Line line) const /* index of the first block in the level that does not end before line */ {
+        const std::vector<TabLayoutBlock>& blocks = levels[level];
+        return std::partition_point(blocks.begin(), blocks.end(), [line](const TabLayoutBlock& tlb) { return tlb.lastLine < line; })
+             - blocks.begin();
+    }
+
+    TabLayoutBlock* find(Scintilla::Line line, size_t level) {
+        if (level >= levels.size()) return 0;
+        size_t i = lowerBound(level, line);
+        if (i >= levels[level].size() || levels[level][i].firstLine > line) return 0;
+        return &levels[level][i];
+    }
+
+    bool hasRight(const TabLayoutBlock& tlb, size_t level) const {
+        if (level + 1 >= levels.size()) return false;
+        size_t i = lowerBound(level + 1, tlb.firstLine);
+        return i < levels[level + 1].size() && levels[level + 1][i].firstLine <= tlb.lastLine;
+    }
+
+    void append(TabLayout& next, bool lineUpAll);
+    void splice(Scintilla::Line firstLine, Scintilla::Line lastLine, Scintilla::Line linesAdded, TabLayout& replacement, size_t fromLevel = 0);
+    Scintilla::Line truncate(Scintilla::Line line);
+
+};
+
+class DocumentSnapshot {
+public:
+    // Read-only view of the Scintilla gap buffer, valid until the document is next modified; safe to read from worker threads.
+    const char* pt1  = 0;          // text before the gap
+    const char* pt2  = 0;          // text after the gap, offset so that pt2[p] is the character at position p
+    intptr_t    gap  = 0;
+    intptr_t    end  = 0;
+    bool        utf8 = false;      // characters are counted as Scintilla counts them in a utf-8 document; otherwise each byte is a character
+    DocumentSnapshot() {}
+    DocumentSnapshot(const char* text, intptr_t length, bool utf8) : pt1(text), gap(length), end(length), utf8(utf8) {}
+    DocumentSnapshot(Scintilla::ScintillaCall& sci) : gap(sci.GapPosition()), end(sci.Length()), utf8(sci.CodePage() == CP_UTF8) {
+        pt1 = gap > 0   ? reinterpret_cast<const char*>(sci.RangePointer(0  , gap      ))       : 0;
+        pt2 = gap < end ? reinterpret_cast<const char*>(sci.RangePointer(gap, end - gap)) - gap : 0;
+    }
+    char at(intptr_t p) const { return p < gap ? pt1[p] : pt2[p]; }
+    const char* contiguous(intptr_t from, intptr_t to, std::string& buffer) const /* the text from..to, copied to buffer if it spans the gap */ {
+        if (to <= gap) return pt1 + from;
+        if (from >= gap) return pt2 + from;
+        buffer.assign(pt1 + from, gap - from);
+        buffer.append(pt2 + gap, to - gap);
+        return buffer.data();
+    }
+};
+
+class VirtualRectangle {
+public:
+    // A rectangular region to which column commands can apply without its being made a Scintilla selection, which for very
+    // large regions is slow to create and to maintain; see RectangularSelection.
+    Scintilla::Line first  = 0;     // first line
+    Scintilla::Line last   = -1;    // last line, or -1 for the last line of the document
+    int             left   = 0;     // horizontal extent in pixels from the start of each line, when column is zero
+    int             right  = 0;
+    int             column = 0;     // if not zero, the region is this tab-delimited column (counting from 1) of each line
+    static VirtualRectangle wholeColumn(int column, Scintilla::Line first = 0, Scintilla::Line last = -1) {
+        VirtualRectangle vr;
+        vr.first  = first;
+        vr.last   = last;
+        vr.column = column;
+        return vr;
+    }
 };
 
+// TabScanner.cpp
+
+class TabScanner {
+public:
+    struct Cell {
+        size_t start;                // offset of the first character of the cell from the beginning of the scanned text
+        size_t end;                  // offset of the tab which ends the cell (or of the end of the text, for an end of line tab)
+        int    characters;           // number of characters in the cell, counted as Scintilla's CountCharacters would
+    };
+    std::vector<Cell> cells;
+    void scan(const DocumentSnapshot& text, intptr_t begin, intptr_t end, bool eolTab);
+    static intptr_t findLineEnd(const DocumentSnapshot& text, intptr_t from, intptr_t limit);
+private:
+    std::string buffer;              // holds a copy of text which spans the gap in the Scintilla buffer
+};
+
+class LineRuns {
+public:
+    // A flag for each line of a document, which can be shifted by inserting or removing lines in O(log n) time (see LineRuns.cpp).
+    void            reset    (Scintilla::Line lineCount);                 // sets the number of lines and clears all of them
+    Scintilla::Line size     () const { return total(root); }
+    bool            test     (Scintilla::Line line) const;
+    void            set      (Scintilla::Line line);
+    void            clear    (Scintilla::Line first, Scintilla::Line last);
+    void            insert   (Scintilla::Line line, Scintilla::Line count);  // inserted lines are clear
+    void            erase    (Scintilla::Line line, Scintilla::Line count);
+    Scintilla::Line nextClear(Scintilla::Line line) const;                // first clear line at or after line, or size() if none
+    Scintilla::Line firstSet (Scintilla::Line line) const;                // first set line at or after line, or size() if none
+    size_t          memoryUsed() const { return nodes.capacity() * sizeof(Node) + freeNodes.capacity() * sizeof(uint32_t); }
+private:
+    struct Node {
+        Scintilla::Line length     = 0;  // lines in this run
+        Scintilla::Line total      = 0;  // lines in the subtree rooted at this node
+        Scintilla::Line clearLines = 0;  // clear lines in the subtree
+        uint32_t        left       = 0;
+        uint32_t        right      = 0;
+        uint32_t        priority   = 0;
+        bool            isSet      = false;
+    };
+    std::vector<Node>     nodes = std::vector<Node>(1);  // nodes[0] is unused, so that zero can mean no node
+    std::vector<uint32_t> freeNodes;
+    uint32_t              root  = 0;
+    uint32_t              seed  = 2463534242;
+    Scintilla::Line total     (uint32_t n) const { return n ? nodes[n].total      : 0; }
+    Scintilla::Line clearLines(uint32_t n) const { return n ? nodes[n].clearLines : 0; }
+    uint32_t        newNode(Scintilla::Line length, bool isSet);
+    void            release(uint32_t n);
+    void            update (uint32_t n);
+    void            split  (uint32_t t, Scintilla::Line lines, uint32_t& left, uint32_t& right);
+    uint32_t        merge  (uint32_t left, uint32_t right);
+    uint32_t        join   (uint32_t left, uint32_t right);
+    void            replace(Scintilla::Line line, Scintilla::Line count, bool isSet);
+    Scintilla::Line find   (uint32_t t, Scintilla::Line from, bool isSet) const;
+};
+
+class AppliedTabstops {
+public:
+    // A 64-bit hash of the tabstops last set on each line of a document, so that lines whose tabstops would not change can be
+    // skipped without asking Scintilla: setting tabstops, even the same ones, makes Scintilla lay out the line again.  Zero means
+    // the tabstops are not known.
+    size_t linesSkipped = 0;         // lines on which the required tabstops were already set
+    size_t linesUpdated = 0;         // lines on which tabstops were changed
+    void            clear  () { hashes.clear(); }
+    void            reset  (Scintilla::Line lineCount) { hashes.assign(lineCount, 0); }
+    Scintilla::Line size   () const { return static_cast<Scintilla::Line>(hashes.size()); }
+    uint64_t        get    (Scintilla::Line line) const { return hashes[line]; }
+    void            put    (Scintilla::Line line, uint64_t hash) { hashes[line] = hash; }
+    void            shift  (Scintilla::Line firstChanged, Scintilla::Line lastChanged, Scintilla::Line linesAdded);
+    static uint64_t hash   (const std::vector<int>& tabs);
+    size_t          memoryUsed() const { return hashes.capacity() * sizeof(uint64_t); }
+private:
+    std::vector<uint64_t> hashes;
+};
+
+class ProgressEstimate {
+public:
+    // Projects whether work done in steps of equal size will take longer than a time limit, from the time taken by the steps since
+    // the last projection.  Times are milliseconds from any clock, so this does not depend on Windows or Scintilla.
+    explicit ProgressEstimate(uint64_t now) : before(now) {}
+    bool exceeds(uint64_t now, double remaining, double stepSize, double limit) {  // call after each step; limit is in seconds
+        ++steps;
+        if (now - before < 20) return false;
+        const double projected = remaining * static_cast<double>(now - before) / (1000 * steps * stepSize);
+        before = now;
+        steps  = 0;
+        return projected > limit;
+    }
+private:
+    uint64_t before;
+    int      steps = 0;
+};
+
+class AnalysisThroughput {
+public:
+    // Keeps rolling averages of the lines and bytes analyzed per second for each profile and font mode (monospace or proportional),
+    // from which the time to analyze a whole document can be predicted.  Short measurements (such as background time slices) are
+    // combined until they cover sampleTime, so that timer resolution does not distort the rates.
+    struct Rate {
+        double   linesPerSecond = 0;
+        double   bytesPerSecond = 0;
+        int      samples        = 0;
+        uint64_t pendingLines   = 0;
+        uint64_t pendingBytes   = 0;
+        uint64_t pendingTime    = 0;  // milliseconds
+    };
+    static constexpr uint64_t sampleTime     = 250;  // milliseconds of measurement combined in one sample
+    static constexpr int      minimumSamples = 2;    // samples required before predictions are made
+    std::map<std::pair<std::wstring, bool>, Rate> rates;
+    void   record (const std::wstring& profile, bool monospace, uint64_t lines, uint64_t bytes, uint64_t milliseconds);
+    double predict(const std::wstring& profile, bool monospace, uint64_t lines, uint64_t bytes) const;  // seconds, or -1 if unknown
+};
+
+class MonospaceMetrics {
+public:
+    int  ch1440;                   // width of 1440 characters
+    int  tabGap;                   // minimum space between columns
+    int  tabInd;                   // width of a leading tab
+    int  tabMin;                   // minimum width of a column
+    bool leadingTabsIndent;
+    bool lineUpAll;
+    bool treatEolAsTab;
+};
+
+// ParallelAnalysis.cpp
+
+TabLayout analyzeMonospace(const DocumentSnapshot& text, intptr_t start, intptr_t end, Scintilla::Line firstLine,
+                           const MonospaceMetrics& metrics, unsigned int chunks);
+
 class ElasticTabsProfile {
 public:
     int minimumOrLeadingTabSize    = 4;
@@ -234,10 +468,96 @@ public:
     bool decimalSeparatorIsComma = false;
 };
 
+class WrapBreakCache {
+public:
+    // Where the line last measured by unwrappedWidth wraps, found as needed from the beginning of the line.  The key members
+    // identify the line and its layout; the cache is also cleared when the line's text or tabstops change.
+    struct Break {
+        Scintilla::Position position;        // first position on the next sub-line
+        int                 endX;            // x coordinate of the right edge of the last character before the wrap
+        int                 startX;          // x coordinate of position
+    };
+    void*               document  = 0;
+    Scintilla::Line     line      = -1;
+    Scintilla::Position lineStart = 0;
+    Scintilla::Position lineEnd   = 0;
+    int                 lineEndX  = 0;
+    Scintilla::Position searched  = 0;       // all breaks at or before this position are in breaks
+    std::vector<Break>  breaks;
+    void clear() {
+        line = -1;
+        breaks.clear();
+    }
+    void clear(void* changedDocument, Scintilla::Line firstChanged, Scintilla::Line lastChanged) {
+        if (document == changedDocument && line >= firstChanged && line <= lastChanged) clear();
+    }
+};
+
+class TextWidthCache {
+public:
+    // Pixel widths of cells measured for proportional-font elastic layouts, keyed by the style runs and the text of the cell,
+    // and per-style widths of printable ASCII characters.  Valid only for the width24b/d/w values in the owning DocumentData.
+    std::unordered_map<std::string, int>  widths;
+    std::array<std::vector<int>, 256>     advances;   // empty until needed for a style; else widths of characters 0x20 - 0x7E
+    size_t hits      = 0;                             // cells found in widths
+    size_t asciiHits = 0;                             // cells measured using advances
+    size_t misses    = 0;                             // cells measured using Scintilla
+    size_t keyBytes  = 0;                             // total capacity of the keys in widths, kept so memoryUsed need not visit them
+    static constexpr size_t maximumEntries = 65536;
+    void clear() {
+        widths.clear();
+        keyBytes = 0;
+        for (auto& advance : advances) advance.clear();
+    }
+    void add(std::string&& key, int width) {
+        if (widths.size() >= maximumEntries) {
+            widths.clear();
+            keyBytes = 0;
+        }
+        keyBytes += widths.emplace(std::move(key), width).first->first.capacity();
+    }
+    double hitRate() const { return hits + asciiHits + misses ? static_cast<double>(hits + asciiHits) / (hits + asciiHits + misses) : 0; }
+    size_t memoryUsed() const /* approximate: allows for a node and a heap block for each entry */ {
+        size_t bytes = widths.bucket_count() * sizeof(void*) + keyBytes
+                     + widths.size() * (sizeof(std::pair<const std::string, int>) + 2 * sizeof(void*) + 16);
+        for (const auto& advance : advances) bytes += advance.capacity() * sizeof(int);
+        return bytes;
+    }
+};
+
+class LayoutCache {
+public:
+    // Layouts of large documents saved between sessions (see LayoutCache.cpp), keyed by ColumnsPlusPlusData::layoutCacheKey.
+    struct Entry {
+        uint64_t  lastUsed = 0;                   // value of useCount when the entry was last stored or found
+        size_t    bytes    = 0;                   // approximate size of the entry in the file
+        TabLayout layout;
+        int64_t   usedAt   = -1;                  // offset of lastUsed in the file, or -1 if the entry is not yet in the file
+    };
+    std::wstring                 filePath;        // set by loadConfiguration; the cache is not saved if empty
+    std::map<std::string, Entry> entries;
+    uint64_t useCount   = 0;
+    size_t   totalBytes = 0;
+    bool     loaded     = false;                  // the file is read the first time the cache is used
+    bool     changed    = false;                  // the file must be written by save
+    bool     touched    = false;                  // only lastUsed values have changed; save rewrites just those
+    static constexpr Scintilla::Line minimumLines   = 10000;     // smaller documents are analyzed quickly, so they are not cached
+    static constexpr size_t          maximumBytes   = 32 << 20;
+    static constexpr size_t          maximumEntries = 64;
+    static bool fits(const TabLayout& layout);  // false if layout is too large to be stored
+    bool find (const std::string& key, TabLayout& layout);
+    void store(const std::string& key, const TabLayout& layout);
+    void load();
+    void save();
+};
+
 class DocumentData {
 public:
     DocumentDataSettings settings;
-    std::vector<TabLayoutBlock> tabLayouts;
+    TabLayout tabLayouts;
+    TextWidthCache widthCache;
+    LineRuns tabsSet;                 // lines for which elastic tabstops have been set; tabstops belong to the document, not the view,
+    AppliedTabstops tabstopsApplied;  //     so both are shared when both views show the document
     UINT_PTR buffer;                              // identifier used by Notepad++ messages and notifications
     int      width24b = 0;                        // the widths of 24 blanks, 24 digits and 24 capital W letters
     int      width24d = 0;                        //     at which tabLayouts were calculated;
@@ -248,6 +568,37 @@ public:
     bool     assumeMonospace           = false;   // set when assuming all fonts used are monospaced
     Scintilla::Position deleteWithoutLayoutChangePosition;
     Scintilla::Position deleteWithoutLayoutChangeLength;
+    Scintilla::Line     changedFirstLine  = -1;   // if not -1, lines changedFirstLine through changedLastLine (current numbering) must be
+    Scintilla::Line     changedLastLine   = -1;   //     re-analyzed; tabLayouts after them still use the numbering from before
+    Scintilla::Line     changedLinesAdded = 0;    //     changedLinesAdded lines were added (or removed, if negative)
+    bool                streaming          = false;  // document exceeds the disableOver... limits: analysis is always done first near
+                                                     //     the visible lines, then for the whole document in the background
+    Scintilla::Line     windowFirstLine    = 0;      // while background analysis is incomplete, tabLayouts is valid only for
+    Scintilla::Line     windowLastLine     = -1;     //     lines windowFirstLine through windowLastLine
+    Scintilla::Line     backgroundNextLine = -1;     // next line for background analysis, or -1 if it is not in progress
+    TabLayout           backgroundLayout;            // layout of lines before backgroundNextLine, built by background analysis
+    bool                paged              = false;  // background analysis exceeded elasticMemoryLimit and was abandoned: only lines
+                                                     //     near those visible or needed are analyzed, as they are required
+    uint64_t            lastActive         = 0;      // value of ColumnsPlusPlusData::activations when the document was last activated
+    bool                cellChangePending  = false;  // set before an insert or delete within one cell; cellChange... describe the
+    Scintilla::Position cellChangePosition;          //     change and the cell, so that the cell widths of its tab layout block
+    Scintilla::Position cellChangeLength;            //     can be updated when the change is made
+    Scintilla::Line     cellChangeLine;
+    size_t              cellChangeLevel;
+    int                 cellChangeWidth;
+    Scintilla::Line     pasteFirstLine     = -1;     // during a rectangular paste of text with tabs, the lines it should change,
+    Scintilla::Line     pasteLastLine      = -1;     //     or -1 if no paste is being tracked (see beforePaste)
+    Scintilla::Line     pasteChangedFirst  = -1;     // lines changed so far by the paste, not yet passed to noteChangedLines,
+    Scintilla::Line     pasteChangedLast   = -1;     //     or -1 if none
+    size_t              pasteLevel;                  // lowest tab layout level at which the paste has inserted text
+    uint64_t            contentHash;                 // hash of the first contentHashed bytes of the document text, used by
+    Scintilla::Position contentHashed      = 0;      //     layoutCacheKey; computed by hashContent, restarted by changes before it
+    bool                layoutCacheFind    = false;  // look for a stored layout when the hash is complete (see elasticBackgroundStep)
+    bool                layoutCacheStore   = false;  // store tabLayouts in layoutCache when the hash is complete
+    size_t memoryUsed() const {
+        return tabLayouts.memoryUsed() + backgroundLayout.memoryUsed() + widthCache.memoryUsed()
+             + tabsSet.memoryUsed() + tabstopsApplied.memoryUsed();
+    }
 };
 
 class ColumnsPlusPlusData {
@@ -264,16 +615,17 @@ public:
     int        aboutMenuItem;                 // Menu item identifiers of items that can be toggled or otherwise updated.
     int        decimalSeparatorMenuItem;
     int        elasticEnabledMenuItem;
+    int        wholeColumnMenuItem;
     CLIPFORMAT clipFormatRectangular;         // The clipboard format which signals a rectangular selection; zero if attempt to register failed
     bool       selectionMouseUpTimerActive = false;
+    UINT_PTR   elasticBackgroundTimer      = 0;  // timer which runs background analysis; zero if not running
+    bool       foregroundAnalysis          = false;  // the elastic progress dialog is open; the background timer must wait
     bool       sentADDSCNMODIFIEDFLAGS = false;
 
     std::map<void*       , DocumentData>       documents;
     std::map<std::wstring, ElasticTabsProfile> profiles;
     std::map<std::wstring, std::wstring>       extensionToProfile = { {L"", L"*"}, {L"*", L"*"} };
 
-    std::vector<char> view1TabsSet;
-    std::vector<char> view2TabsSet;
 
     UpdateInformation     updateInfo;
     DocumentDataSettings  settings;    // these are the settings for the last active document, or else initial settings
@@ -283,9 +635,17 @@ public:
     SortSettings          sort;
     AlignSettings         align;
     TimestampSettings     timestamps;
+    LayoutCache           layoutCache; // elastic tabstop layouts of large documents, kept between sessions
+    WrapBreakCache        wrapBreaks;  // wrap points in the line last measured by unwrappedWidth
+    AnalysisThroughput    throughput;  // measured speed of elastic tabstop analysis, used by exceedsElasticLimits
     int  disableOverSize     = 1000;      // active if greater than zero; if negative, inactive and is negative of last used setting   
     int  disableOverLines    = 5000;      // active if greater than zero; if negative, inactive and is negative of last used setting
     int  elasticProgressTime = 2;         // maximum estimated time remaining in seconds to skip progress dialog for slow elastic tabstop operations
+    int  elasticPrefetchLines = 100;      // lines above and below the visible lines for which elastic tabstops are set in advance of scrolling
+    bool elasticStreaming    = false;     // for files over the disableOver... limits, analyze near the visible lines and finish in the background
+    bool elasticAutoLimits   = true;      // once analysis speed has been measured, also apply the disableOver... limits by predicted time
+    int  elasticMemoryLimit  = 256;       // megabytes of elastic tabstop data to keep for documents not shown in either view; 0 = no limit
+    uint64_t activations     = 0;         // count of buffer activations, used to find the documents least recently shown
     int  timeScalarUnit      = 3;         // time segment as which to interpert a scalar (no colons): 0 = days, 1 = hours, 2 = minutes, 3 = seconds
     int  timePartialRule     = 3;         // interpretation of 2 and 3 segment times: 0 = d:h, d:h:m; 1 = h:m, d:h:m; 2 = h:m, h:m:s; 3 = m:s, h:m:s
     int  timeFormatEnable    = 15;        // bit mask for enabled formats: 8 (4 segments) + 4 (3 segments) + 2 (2 segments) + 1 (1 segment)
@@ -294,22 +654,50 @@ public:
     bool extendSingleLine    = false;     // Extend single line selections to the last line
     bool extendFullLines     = false;     // Extend selections of full lines to the enclosing rectangle
     bool extendZeroWidth     = false;     // Extend zero-width rectangular selections to the right
+    int  virtualSelectionLines = 100000;  // rectangles made from other selections with more lines than this are kept virtual; 0 = never
+    std::optional<VirtualRectangle> rectangularTarget;  // if set, the next column command applies to this instead of the selection
 
     Scintilla::Position positionFromLineAndPointX(Scintilla::Line line, int px) {
         // [Char]PositionFromPoint does not work with negative horizontal positions, but PointXFromPosition does
         Scintilla::Position begin = sci.PositionFromLine(line);
         Scintilla::Position end   = sci.LineEndPosition(line);
-        Scintilla::Position lastI = begin;
-        int                 lastX = px;
-        for (Scintilla::Position i = begin;; i = sci.PositionAfter(i)) {
-            int x = sci.PointXFromPosition(i);
-            if (x == px) return i;
-            if (x > px) return x - px > px - lastX ? lastI : i;
-            lastI = i;
-            lastX = x;
-            if (i >= end) break;
+        if (sci.WrapCount(line) > 1) /* horizontal positions start over on each subline, so search in order */ {
+            Scintilla::Position lastI = begin;
+            int                 lastX = px;
+            for (Scintilla::Position i = begin;; i = sci.PositionAfter(i)) {
+                int x = sci.PointXFromPosition(i);
+                if (x == px) return i;
+                if (x > px) return x - px > px - lastX ? lastI : i;
+                lastI = i;
+                lastX = x;
+                if (i >= end) break;
+            }
+            return end;
+        }
+        if (sci.PointXFromPosition(end) < px) return end;
+        Scintilla::Position low = begin, high = end;  // find the first character boundary at or right of px
+        while (low < high) {
+            const Scintilla::Position middle = sci.PositionBefore(low + (high - low) / 2 + 1);  // start of the character containing it
+            if (sci.PointXFromPosition(middle) >= px) high = middle;
+                                                 else low  = sci.PositionAfter(middle);
+        }
+        Scintilla::Position i = low;
+        int x = sci.PointXFromPosition(i);
+        if (x > px && i > begin) {
+            const Scintilla::Position lastI = sci.PositionBefore(i);
+            const int                 lastX = sci.PointXFromPosition(lastI);
+            if (x - px > px - lastX) {
+                i = lastI;
+                x = lastX;
+            }
+        }
+        else if (x > px) return i;
+        while (i < end) /* don't separate zero-width characters, such as combining marks, from the character they follow */ {
+            const Scintilla::Position next = sci.PositionAfter(i);
+            if (sci.PointXFromPosition(next) != x) break;
+            i = next;
         }
-        return end;
+        return i;
     }
 
     std::wstring getFilePath() const { return getFilePath(SendMessage(nppData._nppHandle, NPPM_GETCURRENTBUFFERID, 0, 0)); }
@@ -363,9 +751,21 @@ public:
         return SendMessage(nppData._nppHandle, NPPM_GETBUFFERIDFROMPOS, cdi1, 0) == SendMessage(nppData._nppHandle, NPPM_GETBUFFERIDFROMPOS, cdi2, 1);
     }
 
-    std::vector<char>* getLineTabsSet() {
-        if (activeScintilla == nppData._scintillaMainHandle  ) return &view1TabsSet;
-        if (activeScintilla == nppData._scintillaSecondHandle) return &view2TabsSet;
+    bool exceedsElasticLimits() {
+        if (disableOverSize <= 0 && disableOverLines <= 0) return false;
+        if ( disableOverSize  > 0 && disableOverSize * 1024 < sci.Length()
+          || disableOverLines > 0 && disableOverLines < sci.LineCount() ) return true;
+        if (elasticAutoLimits) /* a document within the limits is also excluded if its predicted analysis time would need a progress dialog */ {
+            const bool monospace = settings.monospace == ElasticTabsProfile::MonospaceBest ? guessMonospaced()
+                                 : settings.monospace == ElasticTabsProfile::MonospaceAlways;
+            const double predicted = throughput.predict(settings.profileName, monospace, sci.LineCount(), sci.Length());
+            return predicted > elasticProgressTime;
+        }
+        return false;
+    }
+
+    LineRuns* getLineTabsSet(DocumentData& dd) {
+        if (activeScintilla == nppData._scintillaMainHandle || activeScintilla == nppData._scintillaSecondHandle) return &dd.tabsSet;
         return 0;
     }
 
@@ -432,39 +832,32 @@ public:
         }
     }
 
-    int unwrappedWidth(Scintilla::Position from, Scintilla::Position to) {
-        int width = 0;
-        int xLoc = sci.PointXFromPosition(from);
-        int xEnd = sci.PointXFromPosition(to);
-        if (sci.WrapMode() != Scintilla::Wrap::None && sci.WrapCount(sci.LineFromPosition(from)) > 1) {
-            int yLoc = sci.PointYFromPosition(from);
-            int yEnd = sci.PointYFromPosition(to);
-            for (Scintilla::Position next = from + 1; yLoc != yEnd; ++next) {
-                int yNext = sci.PointYFromPosition(next);
-                while (yNext == yLoc) {
-                    ++next;
-                    yNext = sci.PointYFromPosition(next);
-                }
-                width += sci.PointXFromPosition(next - 1) - xLoc;
-                char lastBeforeWrap = sci.CharacterAt(next - 1);
-                char cStringBeforeWrap[] = " ";
-                if (lastBeforeWrap) cStringBeforeWrap[0] = lastBeforeWrap;
-                width += sci.TextWidth(sci.StyleIndexAt(next - 1), cStringBeforeWrap);
-                xLoc = sci.PointXFromPosition(next);
-                yLoc = yNext;
-            }
-        }
-        return xEnd - xLoc;
-    }
-
     // ColumnsPlusPlus.cpp
 
+    int  unwrappedWidth(Scintilla::Position from, Scintilla::Position to);
+    size_t documentMemoryUsed() const;
+    void trimDocuments();
     void analyzeTabstops(DocumentData& dd);
-    bool findTabLayoutBlock(DocumentData& dd, Scintilla::Position position, Scintilla::Position length, TabLayoutBlock*& tlb, int& width);
+    void analyzeTabstops(DocumentData& dd, Scintilla::Line firstChanged, Scintilla::Line lastChanged, Scintilla::Line linesAdded);
+    bool analyzeChangedLines(DocumentData& dd);
+    bool analyzePastedLines(DocumentData& dd, Scintilla::Line firstChanged, Scintilla::Line lastChanged, size_t level);
+    void analyzeWindow(DocumentData& dd, Scintilla::Line firstNeeded = -1, Scintilla::Line lastNeeded = -1);
+    void startBackgroundAnalysis(DocumentData& dd);
+    bool elasticBackgroundStep();
+    void finishBackgroundAnalysis(DocumentData& dd);
+    void installBackgroundLayout(DocumentData& dd, bool cache = true);
+    void noteChangedLines(DocumentData& dd, Scintilla::Line firstChanged, Scintilla::Line lastChanged, Scintilla::Line linesAdded);
+    void beginCellChange(DocumentData& dd, Scintilla::Position position, Scintilla::Position length, size_t level);
+    bool endCellChange(DocumentData& dd, Scintilla::Position position, Scintilla::Position length);
+    bool findTabLayoutBlock(DocumentData& dd, Scintilla::Position position, Scintilla::Position length, TabLayoutBlock*& tlb, int& width,
+                            size_t* level = nullptr);
     void setTabstops(DocumentData& dd, Scintilla::Line firstNeeded = -1, Scintilla::Line lastNeeded = -1, bool skipChooseCaretX = false);
 
     void afterSelectionMouseUp();
     void beforePaste();
+    void afterPaste();
+    bool trackPaste(DocumentData& dd, const Scintilla::NotificationData* scnp);
+    void endPasteTracking(DocumentData& dd);
 
     void bufferActivated();
     void fileClosed     (const NMHDR* nmhdr);
@@ -495,6 +888,12 @@ public:
     void loadConfiguration();
     void saveConfiguration();
 
+    // LayoutCache.cpp
+
+    bool hashContent(DocumentData& dd, uint64_t milliseconds);
+    std::string layoutCacheKey(DocumentData& dd);
+    void cacheLayout(DocumentData& dd);
+
     // Convert.cpp
 
     void separatedValuesToTabs();
@@ -511,8 +910,8 @@ public:
     // NumericFormat.cpp
 
     std::string  formatNumber(double value, const NumericFormat& format) const;
-    NumericParse parseNumber(const std::string& text);
-    bool         getNumericAlignment(const std::string& text, size_t& colonPosition, size_t& decimalPosition);
+    NumericParse parseNumber(std::string_view text);
+    bool         getNumericAlignment(std::string_view text, size_t& colonPosition, size_t& decimalPosition);
 
     // Options.cpp
 
@@ -544,6 +943,7 @@ public:
     void selectLeft();
     void selectRight();
     void selectUp();
+    void targetWholeColumn();
 
     // Sort.cpp
 
@@ -582,6 +982,13 @@ public:
 // for traversing the selections in a rectangular selection and the columns
 // within each line selection, since many commands need to do this.
 // 
+// Rows and cells do not copy the document text: they view it through a
+// DocumentSnapshot shared by the whole selection, so their text is valid
+// only until the document is changed.  RectangularSelection_Row::replace
+// keeps a copy of the row's own text and calls invalidate, after which the
+// next row constructed takes a new snapshot; a change made any other way
+// is detected when the next row is constructed.
+// 
 // Constructors and member functions that are not inline are in Rectangular.cpp.
 
 
@@ -609,6 +1016,15 @@ private:
     int    _size;
     bool   _reverse;
     Scintilla::SelectionMode _mode;
+    mutable DocumentSnapshot _snapshot;
+    mutable bool             _snapshotValid = false;
+    bool                     _virtual       = false;  // rows are found from _region rather than from the Scintilla selection
+    VirtualRectangle         _region;
+
+    void select();
+    void locate();
+    void virtualRow(int index, Scintilla::Position& cpAnchor, Scintilla::Position& vsAnchor,
+                               Scintilla::Position& cpCaret , Scintilla::Position& vsCaret ) const;
 
 public:
 
@@ -617,10 +1033,12 @@ public:
     const int tabWidth;
 
     RectangularSelection(ColumnsPlusPlusData& data);
+    RectangularSelection(ColumnsPlusPlusData& data, const VirtualRectangle& region);
 
     Scintilla::SelectionMode mode()        const { return _mode; }
     int                      size()        const { return _size; }
-    bool                     leftToRight() const { return _anchor.px <= _caret.px; }
+    bool                     isVirtual()   const { return _virtual; }
+    bool                     leftToRight() const { return (_virtual && _region.column) || _anchor.px <= _caret.px; }
     bool                     topToBottom() const { return _anchor.ln <= _caret.ln; }
 
     int blankCount(intptr_t n) const { return static_cast<int>(n >= 0 ? (n * 2880 + blank1440) / (2 * blank1440) : (n * 2880 - blank1440) / (2 * blank1440)); }
@@ -633,6 +1051,9 @@ public:
     RectangularSelection& extend();
     RectangularSelection& refit(bool addLine = false);
 
+    const DocumentSnapshot& snapshot() const;
+    void invalidate() const { _snapshotValid = false; }
+
     const Corner& anchor() const { return _anchor; }
     const Corner& caret () const { return _caret;  }
     const Corner& top   () const { return topToBottom() ? _anchor : _caret; }
@@ -668,23 +1089,30 @@ class RectangularSelection_Row {
     Scintilla::Position _cpAnchor, _cpCaret, _vsAnchor, _vsCaret, _endOfLine;
     Scintilla::Line     _line;
     size_t              _offset;
-    std::string         _text;
+    std::string_view    _text;           // text of the row (from the start of the line in leading tabs mode) in the document
+    std::string         _buffer;         // copy of the text, used in place of _text when _owned is set
+    bool                _owned = false;  // set when the text spans the gap in the document, or the row has been replaced
+    std::string_view    str() const { return _owned ? std::string_view(_buffer) : _text; }
     RectangularSelection_Row(const RectangularSelection& rs, int index) : rs(rs), index(index) {
-        _cpAnchor  = rs.data.sci.SelectionNAnchor(index);
-        _cpCaret   = rs.data.sci.SelectionNCaret(index);
-        _vsAnchor  = rs.data.sci.SelectionNAnchorVirtualSpace(index);
-        _vsCaret   = rs.data.sci.SelectionNCaretVirtualSpace(index);
+        if (rs._virtual) rs.virtualRow(index, _cpAnchor, _vsAnchor, _cpCaret, _vsCaret);
+        else {
+            _cpAnchor = rs.data.sci.SelectionNAnchor(index);
+            _cpCaret  = rs.data.sci.SelectionNCaret(index);
+            _vsAnchor = rs.data.sci.SelectionNAnchorVirtualSpace(index);
+            _vsCaret  = rs.data.sci.SelectionNCaretVirtualSpace(index);
+        }
         _line      = rs.data.sci.LineFromPosition(_cpAnchor);
         _endOfLine = rs.data.sci.LineEndPosition(_line);
+        Scintilla::Position from = cpMin();
+        _offset = 0;
         if (rs.data.settings.elasticEnabled && rs.data.settings.leadingTabsIndent) {
-            Scintilla::Position startOfLine = rs.data.sci.PositionFromLine(_line);
-            _text   = rs.data.sci.StringOfRange(Scintilla::Span(startOfLine, cpMax()));
-            _offset = cpMin() - startOfLine;
-        }
-        else {
-            _text   = rs.data.sci.StringOfRange(Scintilla::Span(cpMin(), cpMax()));
-            _offset = 0;
+            from    = rs.data.sci.PositionFromLine(_line);
+            _offset = cpMin() - from;
         }
+        const DocumentSnapshot& snapshot = rs.snapshot();
+        _owned = from < snapshot.gap && cpMax() > snapshot.gap;
+        const char* text = snapshot.contiguous(from, cpMax(), _buffer);
+        if (!_owned) _text = std::string_view(text, cpMax() - from);
     }
 public:
     const RectangularSelection& rs;
@@ -699,13 +1127,19 @@ public:
     Scintilla::Position vsMax      () const { return std::max(_vsAnchor, _vsCaret); }
     Scintilla::Line     line       () const { return _line; }
     Scintilla::Position endOfLine  () const { return _endOfLine; }
-    std::string_view    text       () const { return std::string_view(_text).substr(_offset); }
+    std::string_view    text       () const { return str().substr(_offset); }
     bool                isEndOfLine() const { return cpMax() == _endOfLine; }
     RectangularSelection_Cell_Iterator begin() const;
     RectangularSelection_Cell_Iterator end() const;
     void replace(const std::string& r) {
+        if (!_owned) /* the document text will change; keep this row's text for any later use */ {
+            _buffer.assign(_text);
+            _owned = true;
+        }
         rs.data.sci.SetTargetRange(cpMin(), cpMax());
         rs.data.sci.ReplaceTarget(r);
+        rs.invalidate();
+        if (rs._virtual) return;  // there is no selection to update
         if (vsMin()) {
             rs.data.sci.SetSelectionNAnchor            (index, cpMin() + r.length());
             rs.data.sci.SetSelectionNCaret             (index, cpMin() + r.length());
@@ -734,19 +1168,20 @@ class RectangularSelection_Cell {
     size_t _end;
     size_t _pastLeadingTabs;
     RectangularSelection_Cell(const RectangularSelection_Row& row, size_t start, size_t& next) : row(row), _start(start) {
-        if (_start >= row._text.length()) {
-            _start = _left = _right = _end = _pastLeadingTabs = row._text.length();
+        const std::string_view s = row.str();
+        if (_start >= s.length()) {
+            _start = _left = _right = _end = _pastLeadingTabs = s.length();
             next = std::string::npos;
             return;
         }
         _pastLeadingTabs = _start;
         if (_start == row._offset && row.rs.data.settings.elasticEnabled && row.rs.data.settings.leadingTabsIndent) {
-            size_t firstNonTab = row._text.find_first_not_of('\t');
-            if (firstNonTab > _start) _pastLeadingTabs = firstNonTab == std::string::npos ? row._text.length() : firstNonTab;
+            size_t firstNonTab = s.find_first_not_of('\t');
+            if (firstNonTab > _start) _pastLeadingTabs = firstNonTab == std::string::npos ? s.length() : firstNonTab;
         }
-        _end = row._text.find_first_of('\t', _pastLeadingTabs);
+        _end = s.find_first_of('\t', _pastLeadingTabs);
         if (_end == std::string::npos) {
-            _end = row._text.length();
+            _end = s.length();
             next = std::string::npos;
         }
         else next = _end + 1;
@@ -754,17 +1189,17 @@ class RectangularSelection_Cell {
             _left = _right = _end;
             return;
         }
-        _left = row._text.find_first_not_of(' ', _pastLeadingTabs);
+        _left = s.find_first_not_of(' ', _pastLeadingTabs);
         if (_left >= _end) {
             _left = _right = _end;
             return;
         }
-        _right = row._text.find_last_not_of(' ', _end - 1) + 1;
+        _right = s.find_last_not_of(' ', _end - 1) + 1;
     }
 public:
     const RectangularSelection_Row& row;
-    std::string         text        () const { return row._text.substr(_start, _end   - _start); }
-    std::string         trim        () const { return row._text.substr(_left , _right - _left ); }
+    std::string_view    text        () const { return row.str().substr(_start, _end   - _start); }
+    std::string_view    trim        () const { return row.str().substr(_left , _right - _left ); }
     std::string         terminator  () const { return isLastInRow() ? "" : "\t"; }
     intptr_t            textLength  () const { return _end   - _start; }
     intptr_t            trimLength  () const { return _right - _left ; }
@@ -774,7 +1209,7 @@ public:
     Scintilla::Position left        () const { return row.cpMin() - row._offset + _left;  }
     Scintilla::Position right       () const { return row.cpMin() - row._offset + _right; }
     Scintilla::Position end         () const { return row.cpMin() - row._offset + _end;   }
-    bool                isLastInRow () const { return _end == row._text.length(); }
+    bool                isLastInRow () const { return _end == row.str().length(); }
     bool                isEndOfLine () const { return end() == row._endOfLine; }
 };
 
@@ -830,5 +1265,11 @@ inline RectangularSelection_Cell_Iterator RectangularSelection_Row::end() const
 }
 
 inline RectangularSelection ColumnsPlusPlusData::getRectangularSelection() {
+    if (rectangularTarget) {
+        const VirtualRectangle target = *rectangularTarget;
+        rectangularTarget.reset();
+        SendMessage(nppData._nppHandle, NPPM_SETMENUITEMCHECK, wholeColumnMenuItem, FALSE);
+        return RectangularSelection(*this, target);
+    }
     return RectangularSelection(*this).extend();
 }
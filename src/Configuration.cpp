@@ -40,6 +40,7 @@ static const std::regex timestampsHeader("\\s*Timestamps\\s*", std::regex::icase
 static const std::regex updateHeader("\\s*Update\\s*", std::regex::icase | std::regex::optimize);
 static const std::regex dataLine("\\s*(\\S+)\\s+(.*\\S)\\s*", std::regex::optimize);
 static const std::regex integerValue("[+-]?\\d{1,20}", std::regex::optimize);
+static const std::regex throughputValue("([01])\\s+(\\d{1,15})\\s+(\\d{1,15})\\s*(.*)", std::regex::optimize);
 
 static std::basic_string<TCHAR> filePath;
 
@@ -83,6 +84,8 @@ void ColumnsPlusPlusData::loadConfiguration() {
         if (!CreateDirectory(pluginsConfigDirectory, NULL)) return;
     filePath = pluginsConfigDirectory;
     filePath += TEXT("\\ColumnsPlusPlus.data");
+    layoutCache.filePath = pluginsConfigDirectory;
+    layoutCache.filePath += L"\\ColumnsPlusPlus.layouts";
 
     std::ifstream file(filePath);
     if (!file) return;
@@ -129,6 +132,8 @@ void ColumnsPlusPlusData::loadConfiguration() {
                 else if (setting == "treateolastab"             ) settings.treatEolAsTab           = value != "0";
                 else if (setting == "overridetabsize"           ) settings.overrideTabSize         = value != "0";
                 else if (setting == "monospacenomnemonics"      ) settings.monospaceNoMnemonics    = value != "0";
+                else if (setting == "elasticstreaming"          ) elasticStreaming                 = value != "0";
+                else if (setting == "elasticautolimits"         ) elasticAutoLimits                = value != "0";
                 else if (setting == "showonmenubar"             ) showOnMenuBar                    = value != "0";
                 else if (setting == "replacestaysput"           ) replaceStaysPut                  = value != "0";
                 else if (setting == "csvquote"                  ) csv.quote                        = value != "0";
@@ -145,6 +150,15 @@ void ColumnsPlusPlusData::loadConfiguration() {
                 else if (setting == "csvreplacetab") csv.replaceTab = decodeDelimitedString(value);
                 else if (setting == "csvreplacelf" ) csv.replaceLF  = decodeDelimitedString(value);
                 else if (setting == "csvreplacecr" ) csv.replaceCR  = decodeDelimitedString(value);
+                else if (setting == "elasticthroughput") /* monospace flag, lines per second, bytes per second, profile name */ {
+                    std::smatch rate;
+                    if (std::regex_match(value, rate, throughputValue)) {
+                        AnalysisThroughput::Rate& r = throughput.rates[{toWide(rate.str(4), CP_UTF8), rate.str(1) == "1"}];
+                        r.linesPerSecond = std::stod(rate.str(2));
+                        r.bytesPerSecond = std::stod(rate.str(3));
+                        r.samples        = AnalysisThroughput::minimumSamples;
+                    }
+                }
                 else if (setting == "monospace") {
                     strlwr(value.data());
                     settings.monospace = value == "yes" ? ElasticTabsProfile::MonospaceAlways
@@ -163,9 +177,12 @@ void ColumnsPlusPlusData::loadConfiguration() {
                     else if (setting == "disableoversize"           ) disableOverSize                     = std::stoi(value);
                     else if (setting == "disableoverlines"          ) disableOverLines                    = std::stoi(value);
                     else if (setting == "elasticprogresstime"       ) elasticProgressTime                 = std::stoi(value);
+                    else if (setting == "elasticprefetchlines"      ) elasticPrefetchLines                = std::stoi(value);
+                    else if (setting == "elasticmemorylimit"        ) elasticMemoryLimit                  = std::stoi(value);
                     else if (setting == "timescalarunit"            ) timeScalarUnit                      = std::stoi(value);
                     else if (setting == "timepartialrule"           ) timePartialRule                     = std::stoi(value);
                     else if (setting == "timeformatenable"          ) timeFormatEnable                    = std::stoi(value);
+                    else if (setting == "virtualselectionlines"     ) virtualSelectionLines               = std::stoi(value);
                 }
             }
             else if (readingSection == sectionCalc) {
@@ -221,6 +238,8 @@ void ColumnsPlusPlusData::loadConfiguration() {
                     else if (setting == "indicator"      ) searchData.indicator     = std::stoi(value);
                     else if (setting == "customalpha"    ) searchData.customAlpha   = std::stoi(value);
                     else if (setting == "customcolor"    ) searchData.customColor   = std::stoi(value);
+                    else if (setting == "countthreads"   ) searchData.countThreads   = std::stoi(value);
+                    else if (setting == "countchunksize" ) searchData.countChunkSize = std::stoi(value);
                     else if (setting == "customindicator") {
                         searchData.userIndicator = std::stoi(value);
                         if (searchData.userIndicator < 0) /* legacy format from before version 4 */ {
@@ -411,6 +430,13 @@ void ColumnsPlusPlusData::saveConfiguration() {
     file << "disableOverSize\t"             << disableOverSize                         << std::endl;
     file << "disableOverLines\t"            << disableOverLines                        << std::endl;
     file << "elasticProgressTime\t"         << elasticProgressTime                     << std::endl;
+    file << "elasticPrefetchLines\t"        << elasticPrefetchLines                    << std::endl;
+    file << "elasticStreaming\t"            << elasticStreaming                        << std::endl;
+    file << "elasticMemoryLimit\t"          << elasticMemoryLimit                      << std::endl;
+    file << "elasticAutoLimits\t"           << elasticAutoLimits                       << std::endl;
+    for (const auto& [key, rate] : throughput.rates) if (rate.samples >= AnalysisThroughput::minimumSamples)
+        file << "elasticThroughput\t" << key.second << ' ' << static_cast<uint64_t>(rate.linesPerSecond) << ' '
+             << static_cast<uint64_t>(rate.bytesPerSecond) << ' ' << fromWide(key.first, CP_UTF8) << std::endl;
     file << "timeScalarUnit\t"              << timeScalarUnit                          << std::endl;
     file << "timePartialRule\t"             << timePartialRule                         << std::endl;
     file << "timeFormatEnable\t"            << timeFormatEnable                        << std::endl;
@@ -419,6 +445,7 @@ void ColumnsPlusPlusData::saveConfiguration() {
     file << "extendSingleLine\t"            << extendSingleLine                        << std::endl;
     file << "extendFullLines\t"             << extendFullLines                         << std::endl;
     file << "extendZeroWidth\t"             << extendZeroWidth                         << std::endl;
+    file << "virtualSelectionLines\t"       << virtualSelectionLines                   << std::endl;
     file << "csvQuote\t"                    << csv.quote                                             << std::endl;
     file << "csvApostrophe\t"               << csv.apostrophe                                        << std::endl;
     file << "csvEscape\t"                   << csv.escape                                            << std::endl;
@@ -470,6 +497,8 @@ void ColumnsPlusPlusData::saveConfiguration() {
     file << "customAlpha\t"           << searchData.customAlpha           << std::endl;
     file << "customColor\t"           << searchData.customColor           << std::endl;
     file << "customIndicator\t"       << searchData.userIndicator         << std::endl;
+    file << "countThreads\t"          << searchData.countThreads          << std::endl;
+    file << "countChunkSize\t"        << searchData.countChunkSize        << std::endl;
     writeDelimitedStringHistory(file, "find"   , searchData.findHistory);
     writeDelimitedStringHistory(file, "replace", searchData.replaceHistory);
 
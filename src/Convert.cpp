@@ -214,6 +214,24 @@ INT_PTR CALLBACK csvDialogProc(HWND hwndDlg, UINT uMsg, WPARAM wParam, LPARAM lP
 }
 
 
+// Find the lines spanned by the selections the conversions will process; an empty single selection means the whole document.
+
+void selectedLineRange(Scintilla::ScintillaCall& sci, Scintilla::Line& first, Scintilla::Line& last) {
+    int selectionCount = sci.Selections();
+    if (selectionCount == 1 && sci.SelectionEmpty()) {
+        first = 0;
+        last  = sci.LineCount() - 1;
+        return;
+    }
+    first = sci.LineCount() - 1;
+    last  = 0;
+    for (int selectionNumber = 0; selectionNumber < selectionCount; ++selectionNumber) {
+        first = std::min(first, sci.LineFromPosition(sci.SelectionNStart(selectionNumber)));
+        last  = std::max(last , sci.LineFromPosition(sci.SelectionNEnd  (selectionNumber)));
+    }
+}
+
+
 void ColumnsPlusPlusData::separatedValuesToTabs() {
     if (DialogBoxParam(dllInstance, MAKEINTRESOURCE(IDD_CSV), nppData._nppHandle,
                        ::csvDialogProc, reinterpret_cast<LPARAM>(this))) return;
@@ -249,6 +267,9 @@ void ColumnsPlusPlusData::separatedValuesToTabs() {
     const std::wstring subSep = (csv.encodingStyle == CsvSettings::TNR && csv.encodeTNR == csv.separator)
                              || (csv.encodingStyle == CsvSettings::URL && csv.encodeURL == csv.separator) ? subEnc : std::wstring(1, csv.separator);
 
+    const Scintilla::Line lineCount = sci.LineCount();
+    Scintilla::Line firstChanged, lastChanged;
+    selectedLineRange(sci, firstChanged, lastChanged);
     sci.BeginUndoAction();
     int selectionCount = sci.Selections();
     for (int selectionNumber = 0; selectionNumber < selectionCount; ++selectionNumber) {
@@ -362,7 +383,7 @@ void ColumnsPlusPlusData::separatedValuesToTabs() {
     sci.EndUndoAction();
     if (settings.elasticEnabled) {
         DocumentData& dd = *getDocument();
-        analyzeTabstops(dd);
+        analyzeTabstops(dd, firstChanged, lastChanged + sci.LineCount() - lineCount, sci.LineCount() - lineCount);
         setTabstops(dd);
     }
 }
@@ -400,6 +421,9 @@ void ColumnsPlusPlusData::tabsToSeparatedValues() {
     const int codepage = sci.CodePage();
     const std::string separator  = fromWide(std::wstring(1, csv.separator), codepage);
     const std::string escapeChar = fromWide(std::wstring(1, csv.escapeChar), codepage);
+    const Scintilla::Line lineCount = sci.LineCount();
+    Scintilla::Line firstChanged, lastChanged;
+    selectedLineRange(sci, firstChanged, lastChanged);
     sci.BeginUndoAction();
     int selectionCount = sci.Selections();
     for (int selectionNumber = 0; selectionNumber < selectionCount; ++selectionNumber) {
@@ -485,7 +509,7 @@ void ColumnsPlusPlusData::tabsToSeparatedValues() {
     sci.EndUndoAction();
     if (settings.elasticEnabled) {
         DocumentData& dd = *getDocument();
-        analyzeTabstops(dd);
+        analyzeTabstops(dd, firstChanged, lastChanged + sci.LineCount() - lineCount, sci.LineCount() - lineCount);
         setTabstops(dd);
     }
 }
@@ -538,7 +562,7 @@ void ColumnsPlusPlusData::tabsToSpaces() {
     }
 
     sci.EndUndoAction();
-    analyzeTabstops(dd);
+    analyzeTabstops(dd, firstSelectedLine, lastSelectedLine, 0);
     setTabstops(dd);
 
 }
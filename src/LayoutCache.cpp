@@ -0,0 +1,221 @@
+// This file is part of Columns++ for Notepad++.
+// Copyright 2026 by Randall Joseph Fellmy <software@coises.com>, <http://www.coises.com/software/>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// Elastic tabstop layouts of large documents are saved in ColumnsPlusPlus.layouts, next to ColumnsPlusPlus.data, so that
+// reopening a file which has not changed does not require analysis.  The file format is:
+//     header:  "Columns++ layouts", a zero byte, and a 32-bit version number
+//     entries: key (32-bit length and bytes), last use (64 bits), level count (32 bits), then for each level a block count
+//              (32 bits) followed by the blocks, each as first line, last line (64 bits each), width and parent (32 bits each)
+// All numbers are little-endian as written by the machine.  A file that cannot be read completely is ignored.  When only the
+// order of use has changed, the last use of each entry is rewritten in place rather than writing the whole file again.
+
+#include "ColumnsPlusPlus.h"
+#include <fstream>
+
+namespace {
+
+constexpr char     fileHeader[] = "Columns++ layouts";
+constexpr uint32_t fileVersion  = 1;
+
+template<typename T> void put(std::ostream& file, T value) { file.write(reinterpret_cast<const char*>(&value), sizeof value); }
+template<typename T> bool get(std::ifstream& file, T& value) { return !!file.read(reinterpret_cast<char*>(&value), sizeof value); }
+
+size_t layoutBytes(const TabLayout& layout) {
+    size_t bytes = 4;
+    for (const auto& level : layout.levels) bytes += 4 + 24 * level.size();
+    return bytes;
+}
+
+}
+
+
+// Hashes the text of the active document, continuing from dd.contentHashed, for up to about the given time; returns true when
+// the hash is complete.  Hashing a large document takes time, so it is done a slice at a time from the background timer; since
+// the hash covers a prefix of the text, changes after contentHashed do not require starting over.
+
+bool ColumnsPlusPlusData::hashContent(DocumentData& dd, uint64_t milliseconds) {
+    const DocumentSnapshot text(sci);
+    if (dd.contentHashed > text.end) dd.contentHashed = 0;
+    if (dd.contentHashed == 0) dd.contentHash = 14695981039346656037ULL;  // 64-bit FNV-1a
+    const uint64_t started = GetTickCount64();
+    while (dd.contentHashed < text.end) {
+        const intptr_t from  = dd.contentHashed;
+        const intptr_t until = std::min(text.end, from + intptr_t(1 << 20));
+        uint64_t hash = dd.contentHash;
+        for (intptr_t p = from; p < std::min(until, text.gap); ++p) hash = (hash ^ static_cast<unsigned char>(text.pt1[p])) * 1099511628211ULL;
+        for (intptr_t p = std::max(from, text.gap); p < until; ++p) hash = (hash ^ static_cast<unsigned char>(text.pt2[p])) * 1099511628211ULL;
+        dd.contentHash   = hash;
+        dd.contentHashed = until;
+        if (GetTickCount64() - started >= milliseconds) break;
+    }
+    return dd.contentHashed == text.end;
+}
+
+
+// Returns a key identifying the content of the active document and everything else on which its layout depends.  The hash of
+// the text must be complete (see hashContent).
+
+std::string ColumnsPlusPlusData::layoutCacheKey(DocumentData& dd) {
+    const DocumentDataSettings& s = dd.settings;
+    return std::to_string(dd.contentHash) + ' ' + std::to_string(sci.Length()) + ' ' + std::to_string(sci.CodePage())
+         + ' ' + std::to_string(s.minimumOrLeadingTabSize) + ' ' + std::to_string(s.minimumSpaceBetweenColumns)
+         + ' ' + std::to_string(s.monospace) + ' ' + std::to_string(s.leadingTabsIndent) + std::to_string(s.lineUpAll)
+         + std::to_string(s.treatEolAsTab) + std::to_string(s.overrideTabSize) + std::to_string(dd.assumeMonospace)
+         + ' ' + std::to_string(sci.TabWidth()) + ' ' + std::to_string(dd.width24b) + ' ' + std::to_string(dd.width24d)
+         + ' ' + std::to_string(dd.width24w);
+}
+
+
+// Stores the layout of the active document if it is large enough to be worth keeping and small enough to fit; if the text has
+// not yet been hashed, sets dd.layoutCacheStore so that the background timer stores it when the hash is complete.
+
+void ColumnsPlusPlusData::cacheLayout(DocumentData& dd) {
+    dd.layoutCacheStore = false;
+    if (sci.LineCount() < LayoutCache::minimumLines || !LayoutCache::fits(dd.tabLayouts)) return;
+    if (dd.contentHashed == sci.Length()) {
+        layoutCache.store(layoutCacheKey(dd), dd.tabLayouts);
+        return;
+    }
+    dd.layoutCacheStore = true;
+}
+
+
+// Returns false if layout is too large to be stored, so that there is no need to compute a key for it.  (The key itself is
+// always much shorter than the allowance made for it here.)
+
+bool LayoutCache::fits(const TabLayout& layout) {
+    return layoutBytes(layout) + 1024 <= maximumBytes / 4;
+}
+
+
+// Copies the layout saved for key, if there is one, to layout and returns true; otherwise returns false.
+
+bool LayoutCache::find(const std::string& key, TabLayout& layout) {
+    if (!loaded) load();
+    auto entry = entries.find(key);
+    if (entry == entries.end()) return false;
+    entry->second.lastUsed = ++useCount;
+    layout = entry->second.layout;
+    touched = true;
+    return true;
+}
+
+
+// Saves a copy of layout for key, then discards the least recently used entries until the cache is within its size limit.
+
+void LayoutCache::store(const std::string& key, const TabLayout& layout) {
+    if (!loaded) load();
+    const size_t bytes = layoutBytes(layout) + key.length();
+    if (bytes > maximumBytes / 4) return;
+    auto existing = entries.find(key);
+    if (existing != entries.end()) {
+        totalBytes -= existing->second.bytes;
+        entries.erase(existing);
+    }
+    entries[key] = { ++useCount, bytes, layout };
+    totalBytes += bytes;
+    while (totalBytes > maximumBytes || entries.size() > maximumEntries) {
+        auto oldest = entries.begin();
+        for (auto i = entries.begin(); i != entries.end(); ++i) if (i->second.lastUsed < oldest->second.lastUsed) oldest = i;
+        totalBytes -= oldest->second.bytes;
+        entries.erase(oldest);
+    }
+    changed = true;
+}
+
+
+void LayoutCache::load() {
+    loaded = true;
+    if (filePath.empty()) return;
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file) return;
+    char header[sizeof fileHeader];
+    uint32_t version;
+    if (!file.read(header, sizeof header) || memcmp(header, fileHeader, sizeof header) || !get(file, version) || version != fileVersion) return;
+    std::map<std::string, Entry> loading;
+    size_t loadingBytes = 0;
+    uint64_t loadingCount = 0;
+    for (uint32_t keyLength; get(file, keyLength);) {
+        if (keyLength > 1024) return;
+        std::string key(keyLength, 0);
+        Entry entry;
+        uint32_t levelCount;
+        if (!file.read(key.data(), keyLength)) return;
+        entry.usedAt = file.tellg();
+        if (!get(file, entry.lastUsed) || !get(file, levelCount) || levelCount > 65536) return;
+        entry.layout.levels.resize(levelCount);
+        for (auto& level : entry.layout.levels) {
+            uint32_t blockCount;
+            if (!get(file, blockCount) || blockCount > maximumBytes / 24) return;
+            level.reserve(blockCount);
+            for (uint32_t i = 0; i < blockCount; ++i) {
+                int64_t  firstLine, lastLine;
+                int32_t  width;
+                uint32_t parent;
+                if (!get(file, firstLine) || !get(file, lastLine) || !get(file, width) || !get(file, parent)) return;
+                level.emplace_back(static_cast<Scintilla::Line>(firstLine), width,
+                                   parent == UINT32_MAX ? TabLayoutBlock::npos : static_cast<size_t>(parent));
+                level.back().lastLine = static_cast<Scintilla::Line>(lastLine);
+                level.back().cells.exact = false;  // cell widths are not saved
+            }
+        }
+        entry.bytes   = layoutBytes(entry.layout) + key.length();
+        loadingBytes += entry.bytes;
+        loadingCount  = std::max(loadingCount, entry.lastUsed);
+        loading[key]  = std::move(entry);
+    }
+    entries    = std::move(loading);
+    totalBytes = loadingBytes;
+    useCount   = loadingCount;
+}
+
+
+void LayoutCache::save() {
+    if (filePath.empty()) return;
+    if (!changed) {
+        if (touched) {
+            std::fstream file(filePath, std::ios::binary | std::ios::in | std::ios::out);
+            for (const auto& [key, entry] : entries) if (file && entry.usedAt >= 0) {
+                file.seekp(entry.usedAt);
+                put(file, entry.lastUsed);
+            }
+            touched = false;
+        }
+        return;
+    }
+    std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
+    if (!file) return;
+    file.write(fileHeader, sizeof fileHeader);
+    put(file, fileVersion);
+    for (auto& [key, entry] : entries) {
+        put(file, static_cast<uint32_t>(key.length()));
+        file.write(key.data(), key.length());
+        entry.usedAt = file.tellp();
+        put(file, entry.lastUsed);
+        put(file, static_cast<uint32_t>(entry.layout.levels.size()));
+        for (const auto& level : entry.layout.levels) {
+            put(file, static_cast<uint32_t>(level.size()));
+            for (const TabLayoutBlock& tlb : level) {
+                put(file, static_cast<int64_t>(tlb.firstLine));
+                put(file, static_cast<int64_t>(tlb.lastLine));
+                put(file, static_cast<int32_t>(tlb.width));
+                put(file, tlb.parent == TabLayoutBlock::npos ? UINT32_MAX : static_cast<uint32_t>(tlb.parent));
+            }
+        }
+    }
+    changed = false;
+    touched = false;
+}
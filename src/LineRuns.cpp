@@ -0,0 +1,229 @@
+// This file is part of Columns++ for Notepad++.
+// Copyright 2026 by Randall Joseph Fellmy <software@coises.com>, <http://www.coises.com/software/>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// LineRuns keeps a set/clear flag for each line of a document as runs of lines with the same flag.  The runs are nodes of a treap
+// ordered by position, each node holding the number of lines in its subtree in place of a key, so that splitting and joining the
+// sequence at any line, and hence inserting or removing lines, takes expected O(log n) time.  Adjacent runs with the same flag are
+// combined whenever an operation creates them, so the number of nodes stays proportional to the number of changes between set
+// and clear lines.
+
+#include "ColumnsPlusPlus.h"
+
+
+void LineRuns::reset(Scintilla::Line lineCount) {
+    nodes.assign(1, Node());
+    freeNodes.clear();
+    root = lineCount > 0 ? newNode(lineCount, false) : 0;
+}
+
+
+bool LineRuns::test(Scintilla::Line line) const {
+    for (uint32_t n = root; n;) {
+        const Node& node = nodes[n];
+        const Scintilla::Line leftTotal = total(node.left);
+        if (line < leftTotal) n = node.left;
+        else if (line < leftTotal + node.length) return node.isSet;
+        else {
+            line -= leftTotal + node.length;
+            n = node.right;
+        }
+    }
+    return false;
+}
+
+
+void LineRuns::set(Scintilla::Line line) {
+    if (line < 0 || line >= size() || test(line)) return;
+    replace(line, 1, true);
+}
+
+
+void LineRuns::clear(Scintilla::Line first, Scintilla::Line last) {
+    first = std::max(first, Scintilla::Line(0));
+    last  = std::min(last, size() - 1);
+    if (first > last || nextClear(first) == first && firstSet(first) > last) return;
+    replace(first, last - first + 1, false);
+}
+
+
+void LineRuns::insert(Scintilla::Line line, Scintilla::Line count) {
+    if (count <= 0) return;
+    uint32_t left, right;
+    split(root, std::clamp(line, Scintilla::Line(0), size()), left, right);
+    root = join(join(left, newNode(count, false)), right);
+}
+
+
+void LineRuns::erase(Scintilla::Line line, Scintilla::Line count) {
+    line  = std::clamp(line, Scintilla::Line(0), size());
+    count = std::min(count, size() - line);
+    if (count <= 0) return;
+    uint32_t left, middle, right;
+    split(root, line, left, right);
+    split(right, count, middle, right);
+    release(middle);
+    root = join(left, right);
+}
+
+
+Scintilla::Line LineRuns::nextClear(Scintilla::Line line) const {
+    const Scintilla::Line found = find(root, std::max(line, Scintilla::Line(0)), false);
+    return found < 0 ? size() : found;
+}
+
+
+Scintilla::Line LineRuns::firstSet(Scintilla::Line line) const {
+    const Scintilla::Line found = find(root, std::max(line, Scintilla::Line(0)), true);
+    return found < 0 ? size() : found;
+}
+
+
+uint32_t LineRuns::newNode(Scintilla::Line length, bool isSet) {
+    uint32_t n;
+    if (freeNodes.empty()) {
+        n = static_cast<uint32_t>(nodes.size());
+        nodes.emplace_back();
+    }
+    else {
+        n = freeNodes.back();
+        freeNodes.pop_back();
+    }
+    seed ^= seed << 13;  // xorshift32
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    Node& node    = nodes[n];
+    node.length   = length;
+    node.left     = 0;
+    node.right    = 0;
+    node.priority = seed;
+    node.isSet    = isSet;
+    update(n);
+    return n;
+}
+
+
+void LineRuns::release(uint32_t n) {
+    if (!n) return;
+    release(nodes[n].left);
+    release(nodes[n].right);
+    freeNodes.push_back(n);
+}
+
+
+void LineRuns::update(uint32_t n) {
+    Node& node = nodes[n];
+    node.total      = total(node.left) + node.length + total(node.right);
+    node.clearLines = clearLines(node.left) + (node.isSet ? 0 : node.length) + clearLines(node.right);
+}
+
+
+// Divide the tree t into left, holding the first lines, and right, holding the rest; a run is divided if necessary.
+
+void LineRuns::split(uint32_t t, Scintilla::Line lines, uint32_t& left, uint32_t& right) {
+    if (!t) {
+        left = right = 0;
+        return;
+    }
+    const Scintilla::Line leftTotal = total(nodes[t].left);
+    if (lines <= leftTotal) {
+        uint32_t l = nodes[t].left;
+        split(l, lines, left, l);
+        nodes[t].left = l;
+        update(t);
+        right = t;
+    }
+    else if (lines >= leftTotal + nodes[t].length) {
+        uint32_t r = nodes[t].right;
+        split(r, lines - leftTotal - nodes[t].length, r, right);
+        nodes[t].right = r;
+        update(t);
+        left = t;
+    }
+    else /* the division falls within this node's run */ {
+        const Scintilla::Line before = lines - leftTotal;
+        const uint32_t after = newNode(nodes[t].length - before, nodes[t].isSet);
+        right = merge(after, nodes[t].right);
+        nodes[t].length = before;
+        nodes[t].right  = 0;
+        update(t);
+        left = t;
+    }
+}
+
+
+uint32_t LineRuns::merge(uint32_t left, uint32_t right) {
+    if (!left ) return right;
+    if (!right) return left;
+    if (nodes[left].priority > nodes[right].priority) {
+        const uint32_t r = merge(nodes[left].right, right);
+        nodes[left].right = r;
+        update(left);
+        return left;
+    }
+    const uint32_t l = merge(left, nodes[right].left);
+    nodes[right].left = l;
+    update(right);
+    return right;
+}
+
+
+// Merge two trees, combining the last run of left with the first run of right if they have the same flag.
+
+uint32_t LineRuns::join(uint32_t left, uint32_t right) {
+    if (!left || !right) return merge(left, right);
+    uint32_t last = left;
+    while (nodes[last].right) last = nodes[last].right;
+    uint32_t first = right;
+    while (nodes[first].left) first = nodes[first].left;
+    if (nodes[last].isSet != nodes[first].isSet) return merge(left, right);
+    const bool isSet = nodes[first].isSet;
+    uint32_t lastRun, firstRun;
+    split(left , nodes[left].total - nodes[last].length, left, lastRun);
+    split(right, nodes[first].length, firstRun, right);
+    const Scintilla::Line length = nodes[lastRun].length + nodes[firstRun].length;
+    release(lastRun);
+    release(firstRun);
+    return merge(merge(left, newNode(length, isSet)), right);
+}
+
+
+// Replace count lines beginning at line with a single run having the given flag.
+
+void LineRuns::replace(Scintilla::Line line, Scintilla::Line count, bool isSet) {
+    uint32_t left, middle, right;
+    split(root, line, left, right);
+    split(right, count, middle, right);
+    release(middle);
+    root = join(join(left, newNode(count, isSet)), right);
+}
+
+
+// Returns the first line at or after from in the tree t with the given flag, counting from the beginning of t, or -1 if there is none.
+
+Scintilla::Line LineRuns::find(uint32_t t, Scintilla::Line from, bool isSet) const {
+    if (!t || from >= nodes[t].total) return -1;
+    const Node& node = nodes[t];
+    if ((isSet ? node.total - node.clearLines : node.clearLines) == 0) return -1;
+    const Scintilla::Line leftTotal = total(node.left);
+    if (from < leftTotal) {
+        const Scintilla::Line found = find(node.left, from, isSet);
+        if (found >= 0) return found;
+        from = leftTotal;
+    }
+    if (from < leftTotal + node.length && node.isSet == isSet) return std::max(from, leftTotal);
+    const Scintilla::Line found = find(node.right, std::max(from - leftTotal - node.length, Scintilla::Line(0)), isSet);
+    return found < 0 ? -1 : leftTotal + node.length + found;
+}
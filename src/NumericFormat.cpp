@@ -179,7 +179,7 @@ std::string ColumnsPlusPlusData::formatNumber(double value, const NumericFormat&
 }
 
 
-NumericParse ColumnsPlusPlusData::parseNumber(const std::string& text) {
+NumericParse ColumnsPlusPlusData::parseNumber(std::string_view text) {
 
     NumericParse numericParse;
 
@@ -354,7 +354,7 @@ NumericParse ColumnsPlusPlusData::parseNumber(const std::string& text) {
 }
 
 
-bool ColumnsPlusPlusData::getNumericAlignment(const std::string& text, size_t& colonPosition, size_t& decimalPosition) {
+bool ColumnsPlusPlusData::getNumericAlignment(std::string_view text, size_t& colonPosition, size_t& decimalPosition) {
 
     static const std::wstring inside = L".,:'0123456789 \u00A0\u2000\u2001\u2002\u2003\u2004\u2005\u2006\u2007\u2008\u2009\u200A\u202F\u205F";
 
@@ -57,6 +57,7 @@ BOOL ColumnsPlusPlusData::optionsDialogProc(HWND hwndDlg, UINT uMsg, WPARAM wPar
                                             (rcNpp.top + rcNpp.bottom + rcDlg.top - rcDlg.bottom) / 2, 0, 0, SWP_NOSIZE);
             SendDlgItemMessage(hwndDlg, IDC_OPTIONS_MENUBAR           , BM_SETCHECK, showOnMenuBar                    ? BST_CHECKED : BST_UNCHECKED, 0);
             SendDlgItemMessage(hwndDlg, IDC_OPTIONS_REPLACE_STAYS_PUT , BM_SETCHECK, replaceStaysPut                  ? BST_CHECKED : BST_UNCHECKED, 0);
+            SendDlgItemMessage(hwndDlg, IDC_OPTIONS_ELASTIC_STREAMING , BM_SETCHECK, elasticStreaming                 ? BST_CHECKED : BST_UNCHECKED, 0);
             SendDlgItemMessage(hwndDlg, IDC_OPTIONS_EXTEND_SINGLELINE , BM_SETCHECK, extendSingleLine                 ? BST_CHECKED : BST_UNCHECKED, 0);
             SendDlgItemMessage(hwndDlg, IDC_OPTIONS_EXTEND_ROWS       , BM_SETCHECK, extendFullLines                  ? BST_CHECKED : BST_UNCHECKED, 0);
             SendDlgItemMessage(hwndDlg, IDC_OPTIONS_EXTEND_ZEROWIDTH  , BM_SETCHECK, extendZeroWidth                  ? BST_CHECKED : BST_UNCHECKED, 0);
@@ -164,6 +165,7 @@ BOOL ColumnsPlusPlusData::optionsDialogProc(HWND hwndDlg, UINT uMsg, WPARAM wPar
             elasticProgressTime = newElasticProgressTime;
             showOnMenuBar    = SendDlgItemMessage(hwndDlg, IDC_OPTIONS_MENUBAR          , BM_GETCHECK, 0, 0) == BST_CHECKED;
             replaceStaysPut  = SendDlgItemMessage(hwndDlg, IDC_OPTIONS_REPLACE_STAYS_PUT, BM_GETCHECK, 0, 0) == BST_CHECKED;
+            elasticStreaming = SendDlgItemMessage(hwndDlg, IDC_OPTIONS_ELASTIC_STREAMING, BM_GETCHECK, 0, 0) == BST_CHECKED;
             extendSingleLine = SendDlgItemMessage(hwndDlg, IDC_OPTIONS_EXTEND_SINGLELINE, BM_GETCHECK, 0, 0) == BST_CHECKED;
             extendFullLines  = SendDlgItemMessage(hwndDlg, IDC_OPTIONS_EXTEND_ROWS      , BM_GETCHECK, 0, 0) == BST_CHECKED;
             extendZeroWidth  = SendDlgItemMessage(hwndDlg, IDC_OPTIONS_EXTEND_ZEROWIDTH , BM_GETCHECK, 0, 0) == BST_CHECKED;
@@ -0,0 +1,105 @@
+// This file is part of Columns++ for Notepad++.
+// Copyright 2026 by Randall Joseph Fellmy <software@coises.com>, <http://www.coises.com/software/>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// Elastic tabstop analysis for monospaced layouts, where the width of a cell depends only on the number of characters it contains.
+// The work uses only a DocumentSnapshot (no Scintilla calls), so it can be split among worker threads; the partial layouts are then
+// stitched together to give exactly the result ElasticProgressInfo::analyzeTabstops would produce.
+
+#include "ColumnsPlusPlus.h"
+#include <thread>
+
+namespace {
+
+// Analyze the lines that begin in [start, end), numbering the first one zero; limit is the end of the text being analyzed.
+// Sets lineCount to the number of lines begun.
+
+void analyzeChunk(const DocumentSnapshot& text, intptr_t start, intptr_t end, intptr_t limit,
+                  const MonospaceMetrics& metrics, TabLayout& analysis, Scintilla::Line& lineCount) {
+    TabScanner scanner;
+    Scintilla::Line lineNum = 0;
+    for (intptr_t begin = start, next; begin < end; begin = next, ++lineNum) {
+        const intptr_t lineEnd = TabScanner::findLineEnd(text, begin, limit);
+        next = lineEnd >= limit ? limit
+             : text.at(lineEnd) == '\r' && lineEnd + 1 < limit && text.at(lineEnd + 1) == '\n' ? lineEnd + 2 : lineEnd + 1;
+        if (begin == lineEnd) continue;
+        scanner.scan(text, begin, lineEnd, metrics.treatEolAsTab);
+        const std::vector<TabScanner::Cell>& cells = scanner.cells;
+        size_t first = 0;
+        if (metrics.leadingTabsIndent) {
+            while (first < cells.size() && cells[first].end == first) ++first;
+            if (first == cells.size()) continue;
+        }
+        int indentSize = static_cast<int>(first) * metrics.tabInd;
+        size_t parent = TabLayoutBlock::npos;
+        for (size_t cell = first, level = 0; cell < cells.size(); ++cell, ++level) {
+            if (level >= analysis.levels.size()) analysis.levels.emplace_back();
+            std::vector<TabLayoutBlock>& layouts = analysis.levels[level];
+            if ( layouts.empty() || layouts.back().parent != parent
+              || (!metrics.lineUpAll && layouts.back().lastLine < lineNum - 1) ) layouts.emplace_back(lineNum, metrics.tabMin, parent);
+            TabLayoutBlock& tlb = layouts.back();
+            tlb.lastLine = lineNum;
+            int width = static_cast<int>((static_cast<long long>(cells[cell].characters) * metrics.ch1440 + 720) / 1440);
+            width += metrics.tabGap + indentSize;
+            indentSize = 0;
+            if (width > tlb.width) tlb.width = width;
+            tlb.cells.add(width);
+            parent = layouts.size() - 1;
+        }
+    }
+    lineCount = lineNum;
+}
+
+} // end unnamed namespace
+
+
+// Analyze the lines from start (which must be the beginning of a line) to end (which must be the end of a line, excluding
+// the line terminator), numbering the first line firstLine.  The text is divided at line boundaries into the given number of chunks,
+// which are analyzed concurrently.  Lines may end with CR, LF or CR LF; Unicode line ends are not recognized.
+
+TabLayout analyzeMonospace(const DocumentSnapshot& text, intptr_t start, intptr_t end, Scintilla::Line firstLine,
+                           const MonospaceMetrics& metrics, unsigned int chunks) {
+
+    if (chunks < 1) chunks = 1;
+    std::vector<intptr_t> boundary(chunks + 1, end);
+    boundary[0] = start;
+    for (unsigned int i = 1; i < chunks; ++i) {
+        intptr_t p = std::max(boundary[i - 1], start + static_cast<intptr_t>((end - start) * static_cast<double>(i) / chunks));
+        while (p < end && p > start && !(text.at(p - 1) == '\n' || (text.at(p - 1) == '\r' && text.at(p) != '\n'))) ++p;
+        boundary[i] = p;
+    }
+
+    std::vector<TabLayout>       layouts(chunks);
+    std::vector<Scintilla::Line> lineCounts(chunks, 0);
+    std::vector<std::thread>     workers;
+    for (unsigned int i = 1; i < chunks; ++i)
+        workers.emplace_back(analyzeChunk, std::cref(text), boundary[i], boundary[i + 1], end,
+                             std::cref(metrics), std::ref(layouts[i]), std::ref(lineCounts[i]));
+    analyzeChunk(text, boundary[0], boundary[1], end, metrics, layouts[0], lineCounts[0]);
+    for (auto& worker : workers) worker.join();
+
+    TabLayout& result = layouts[0];
+    Scintilla::Line offset = firstLine;
+    for (unsigned int i = 0; i < chunks; ++i) {
+        if (offset) for (auto& level : layouts[i].levels) for (auto& tlb : level) {
+            tlb.firstLine += offset;
+            tlb.lastLine  += offset;
+        }
+        offset += lineCounts[i];
+        if (i) result.append(layouts[i], metrics.lineUpAll);
+    }
+    return std::move(result);
+
+}
@@ -36,6 +36,8 @@ static void getScintillaPointers() {
 static void cmdWrap(void (ColumnsPlusPlusData::* cmdFunction)()) {
     bypassNotifications = true;
     getScintillaPointers();
+    auto active = data.documents.find(data.sci.DocPointer());
+    if (active != data.documents.end()) active->second.contentHashed = 0;  // commands can change text without notifications
     (data.*cmdFunction)();
     bypassNotifications = false;
 }
@@ -43,11 +45,18 @@ static void cmdWrap(void (ColumnsPlusPlusData::* cmdFunction)()) {
 static LRESULT __stdcall nppSubclassProcedure(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam, UINT_PTR, DWORD_PTR) {
     if (uMsg == WM_COMMAND && lParam == 0) switch (LOWORD(wParam)) {
     case IDM_EDIT_PASTE:
+    {
         bypassNotifications = true;
         getScintillaPointers();
         data.beforePaste();
         bypassNotifications = false;
-        break;
+        const LRESULT result = DefSubclassProc(hWnd, uMsg, wParam, lParam);
+        bypassNotifications = true;
+        getScintillaPointers();
+        data.afterPaste();
+        bypassNotifications = false;
+        return result;
+    }
     }
     return DefSubclassProc(hWnd, uMsg, wParam, lParam);
 }
@@ -61,6 +70,18 @@ void __stdcall catchSelectionMouseUp(HWND hwnd, UINT, UINT_PTR uIDEvent, DWORD)
     bypassNotifications = false;
 }
 
+void __stdcall continueElasticAnalysis(HWND, UINT, UINT_PTR, DWORD) {
+    if (bypassNotifications) return;  // a command is in progress
+    if (data.foregroundAnalysis) return;  // called from the message loop of the elastic progress dialog
+    bypassNotifications = true;
+    getScintillaPointers();
+    if (!data.elasticBackgroundStep()) {
+        KillTimer(0, data.elasticBackgroundTimer);
+        data.elasticBackgroundTimer = 0;
+    }
+    bypassNotifications = false;
+}
+
 static NPP::ShortcutKey SKUp      { true, true, false, VK_UP    };
 static NPP::ShortcutKey SKLeft    { true, true, false, VK_LEFT  };
 static NPP::ShortcutKey SKEnclose { true, true, false, VK_HOME  };
@@ -105,6 +126,7 @@ static struct MenuDefinition {
     FuncItem selectDown              = {TEXT("Select Down"      ), []() {cmdWrap(&ColumnsPlusPlusData::selectDown   );}, 0, false, &SKDown   };
     FuncItem selectEnclose           = {TEXT("Enclose Selection"), []() {cmdWrap(&ColumnsPlusPlusData::selectEnclose);}, 0, false, &SKEnclose};
     FuncItem selectExtend            = {TEXT("Extend Selection" ), []() {cmdWrap(&ColumnsPlusPlusData::selectExtend );}, 0, false, &SKExtend };
+    FuncItem targetWholeColumn       = {TEXT("Whole Column"     ), []() {cmdWrap(&ColumnsPlusPlusData::targetWholeColumn);}, 0, false, 0  };
 } menuDefinition;
 
 BOOL APIENTRY DllMain(HINSTANCE instance, DWORD reasonForCall, LPVOID) {
@@ -211,6 +233,7 @@ extern "C" __declspec(dllexport) void beNotified(SCNotification *np) {
             data.aboutMenuItem            = menuDefinition.about                  ._cmdID;
             data.decimalSeparatorMenuItem = menuDefinition.decimalSeparatorIsComma._cmdID;
             data.elasticEnabledMenuItem   = menuDefinition.elasticEnabled         ._cmdID;
+            data.wholeColumnMenuItem      = menuDefinition.targetWholeColumn      ._cmdID;
             data.clipFormatRectangular    = static_cast<CLIPFORMAT>(RegisterClipboardFormat(L"MSDEVColumnSelect"));
             data.buildSelectionMenu(static_cast<int>((&menuDefinition.about - &menuDefinition.elasticEnabled) + 1),
                                     static_cast<int>((&menuDefinition.search - &menuDefinition.elasticEnabled)));
@@ -235,6 +258,7 @@ extern "C" __declspec(dllexport) void beNotified(SCNotification *np) {
         case NPPN_SHUTDOWN:
             RemoveWindowSubclass(data.nppData._nppHandle, nppSubclassProcedure, 0);
             data.saveConfiguration();
+            data.layoutCache.save();
             break;
 
         }
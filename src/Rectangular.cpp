@@ -195,12 +195,34 @@ INT_PTR CALLBACK chooseRectangularSelectionDialogProc(HWND hwndDlg, UINT uMsg, W
 }
 
 
+// Returns the horizontal offset, from the start of a line, of text which follows the tab at the end of before (the text of the
+// line up to that point) according to the elastic tabstop layout; or -1 if it cannot be determined from the layout.
+
+static int elasticTabOffset(DocumentData& dd, Scintilla::Line line, std::string_view before, int tabInd) {
+    if (before.empty() || before.back() != '\t') return -1;
+    if ( dd.elasticAnalysisRequired || dd.changedFirstLine >= 0 || !dd.tabsSet.test(line)
+      || (dd.backgroundNextLine >= 0 && (line < dd.windowFirstLine || line > dd.windowLastLine)) ) return -1;
+    size_t leading = 0;
+    if (dd.settings.leadingTabsIndent) while (leading < before.length() && before[leading] == '\t') ++leading;
+    if (leading == before.length()) return static_cast<int>(leading) * tabInd;
+    const size_t tabs = std::count(before.begin() + leading, before.end(), '\t');
+    int offset = 0;
+    for (size_t level = 0; level < tabs; ++level) {
+        const TabLayoutBlock* tlb = dd.tabLayouts.find(line, level);
+        if (!tlb) return -1;
+        offset += tlb->width;
+    }
+    return offset;
+}
+
+
 RectangularSelection& RectangularSelection::refit(bool addLine) {
 
+    invalidate();
     if (!_size) return *this;
     if (data.settings.elasticEnabled) {
         DocumentData* ddp = data.getDocument();
-        data.analyzeTabstops(*ddp);
+        data.analyzeTabstops(*ddp, std::min(_anchor.ln, _caret.ln), std::max(_anchor.ln, _caret.ln) + (addLine ? 1 : 0), addLine ? 1 : 0);
         Scintilla::Position firstVisible = data.sci.FirstVisibleLine();
         Scintilla::Position lastVisible  = firstVisible + data.sci.LinesOnScreen();
         data.setTabstops(*ddp, std::min(std::min(_anchor.ln, _caret.ln), firstVisible),
@@ -211,15 +233,44 @@ RectangularSelection& RectangularSelection::refit(bool addLine) {
                                      // position first.  Not sure why... sounds like a dirty cache
                                      // that isn't marked as such.  Likely related to setTabstops().
 
+    if (_virtual) /* a virtual rectangle keeps its bounds; only its corners need to be found again */ {
+        if (addLine) {
+            ++_region.last;
+            ++_size;
+        }
+        locate();
+        return *this;
+    }
+
+    // Where a selection begins at the start of a line or just after a tab, its horizontal position is known from the elastic
+    // tabstop layout without asking Scintilla to lay out the line; selections which are empty need only one position.
+
+    DocumentData* ddp = data.settings.elasticEnabled && data.sci.WrapMode() == Scintilla::Wrap::None ? data.getDocument() : 0;
+    const int lineStartX = data.sci.PointXFromPosition(data.sci.PositionFromLine(std::min(_anchor.ln, _caret.ln)));
+    const int tabInd     = !ddp ? 0 : data.sci.TextWidth(STYLE_DEFAULT, std::string(ddp->settings.overrideTabSize
+                                                        ? ddp->settings.minimumOrLeadingTabSize : tabWidth, ' ').data());
+    std::string buffer;
+    auto pointX = [&](Scintilla::Position cp) {
+        if (ddp) {
+            const Scintilla::Line     line  = data.sci.LineFromPosition(cp);
+            const Scintilla::Position start = data.sci.PositionFromLine(line);
+            if (cp == start) return lineStartX;
+            const int offset = elasticTabOffset(*ddp, line, std::string_view(snapshot().contiguous(start, cp, buffer), cp - start), tabInd);
+            if (offset >= 0) return lineStartX + offset;
+        }
+        return static_cast<int>(data.sci.PointXFromPosition(cp));
+    };
+
     int pxLeft  = std::numeric_limits<int>::max();
     int pxRight = 0;
     for (int i = 0; i < _size; ++i) {
         Scintilla::Position cpMin = data.sci.SelectionNStart(i);
         Scintilla::Position vsMin = data.sci.SelectionNStartVirtualSpace(i);
         Scintilla::Position cpMax = data.sci.SelectionNEnd(i);
-        int px = data.sci.PointXFromPosition(cpMin) + blankWidth(vsMin);
+        const int pxMin = pointX(cpMin);
+        int px = pxMin + blankWidth(vsMin);
         if (px < pxLeft) pxLeft = px;
-        px = data.sci.PointXFromPosition(cpMax);
+        px = cpMax == cpMin ? pxMin : pointX(cpMax);
         if (px > pxRight) pxRight = px;
     }
 
@@ -249,6 +300,26 @@ RectangularSelection& RectangularSelection::refit(bool addLine) {
 }
 
 
+// Returns the snapshot through which rows view the document, taking it again if it has been invalidated or if the gap buffer
+// has changed since it was taken (which means the document has been changed without calling invalidate).
+
+const DocumentSnapshot& RectangularSelection::snapshot() const {
+    auto& sci = data.sci;
+    if (_snapshotValid) {
+        const Scintilla::Position gap = sci.GapPosition();
+        const Scintilla::Position end = sci.Length();
+        _snapshotValid = gap == _snapshot.gap && end == _snapshot.end
+            && (gap <= 0   || reinterpret_cast<const char*>(sci.RangePointer(0  , gap      ))       == _snapshot.pt1)
+            && (gap >= end || reinterpret_cast<const char*>(sci.RangePointer(gap, end - gap)) - gap == _snapshot.pt2);
+    }
+    if (!_snapshotValid) {
+        _snapshot      = DocumentSnapshot(sci);
+        _snapshotValid = true;
+    }
+    return _snapshot;
+}
+
+
 RectangularSelection::RectangularSelection(ColumnsPlusPlusData& data)
     : data(data), blank1440(data.sci.TextWidth(STYLE_DEFAULT, std::string(1440, ' ').data())), tabWidth(data.sci.TabWidth()) {
     _mode   = data.sci.SelectionMode();
@@ -260,6 +331,107 @@ RectangularSelection::RectangularSelection(ColumnsPlusPlusData& data)
 }
 
 
+// A virtual rectangle finds the text of each row from its line and horizontal extent, or from its line and column number, when
+// the row is used; no Scintilla selection is made, so commands can work on a million lines as readily as on a few.
+
+RectangularSelection::RectangularSelection(ColumnsPlusPlusData& data, const VirtualRectangle& region)
+    : data(data), blank1440(data.sci.TextWidth(STYLE_DEFAULT, std::string(1440, ' ').data())), tabWidth(data.sci.TabWidth()) {
+    _mode    = Scintilla::SelectionMode::Rectangle;
+    _virtual = true;
+    _region  = region;
+    _reverse = false;
+    const Scintilla::Line lastLine = data.sci.LineCount() - 1;
+    if (_region.last < 0 || _region.last > lastLine) _region.last = lastLine;
+    _region.first = std::clamp(_region.first, Scintilla::Line(0), _region.last);
+    if (_region.column < 0 || _region.last - _region.first >= std::numeric_limits<int>::max()) {
+        _size   = 0;
+        _anchor = _caret = corner(0, 0);
+        return;
+    }
+    _size = static_cast<int>(_region.last - _region.first + 1);
+    if (data.settings.elasticEnabled && !_region.column) data.setTabstops(*data.getDocument(), _region.first, _region.last);
+    locate();
+}
+
+
+// Makes the rectangle between _anchor and _caret the Scintilla selection; but if it has more lines than virtualSelectionLines,
+// keeps it as a virtual rectangle instead and leaves the Scintilla selection as it was.
+
+void RectangularSelection::select() {
+    const Scintilla::Line first = std::min(_anchor.ln, _caret.ln);
+    const Scintilla::Line last  = std::max(_anchor.ln, _caret.ln);
+    if (data.virtualSelectionLines <= 0 || last - first < data.virtualSelectionLines) {
+        data.sci.SetRectangularSelectionAnchor            (_anchor.cp);
+        data.sci.SetRectangularSelectionAnchorVirtualSpace(_anchor.vs);
+        data.sci.SetRectangularSelectionCaret             (_caret.cp );
+        data.sci.SetRectangularSelectionCaretVirtualSpace (_caret.vs );
+        return;
+    }
+    _virtual       = true;
+    _region.first  = first;
+    _region.last   = last;
+    _region.left   = std::min(_anchor.px, _caret.px);
+    _region.right  = std::max(_anchor.px, _caret.px);
+    _region.column = 0;
+    _size          = static_cast<int>(last - first + 1);
+    _reverse       = false;
+    locate();
+}
+
+
+// Sets the corners of a virtual rectangle: the anchor is at the top left and the caret at the bottom right.
+
+void RectangularSelection::locate() {
+    Scintilla::Position cpAnchor, vsAnchor, cpCaret, vsCaret;
+    virtualRow(0, cpAnchor, vsAnchor, cpCaret, vsCaret);
+    _anchor = corner(cpAnchor, vsAnchor);
+    virtualRow(_size - 1, cpAnchor, vsAnchor, cpCaret, vsCaret);
+    _caret = corner(cpCaret, vsCaret);
+    if (!_region.column) {
+        _anchor.px = _region.left;
+        _caret .px = _region.right;
+    }
+}
+
+
+// Finds the ends of a row of a virtual rectangle as they would be in a rectangular selection of the same region; for a column,
+// leading tabs are skipped when they are indentation, and a line with fewer columns gives an empty row at the end of the line.
+
+void RectangularSelection::virtualRow(int index, Scintilla::Position& cpAnchor, Scintilla::Position& vsAnchor,
+                                                 Scintilla::Position& cpCaret , Scintilla::Position& vsCaret ) const {
+    const Scintilla::Line     line  = _region.first + index;
+    const Scintilla::Position start = data.sci.PositionFromLine(line);
+    const Scintilla::Position end   = data.sci.LineEndPosition(line);
+    vsAnchor = vsCaret = 0;
+    if (_region.column) {
+        const DocumentSnapshot& text = snapshot();
+        Scintilla::Position p = start;
+        if (data.settings.elasticEnabled && data.settings.leadingTabsIndent) while (p < end && text.at(p) == '\t') ++p;
+        for (int n = 1; n < _region.column && p < end; ++n) {
+            while (p < end && text.at(p) != '\t') ++p;
+            if (p < end) ++p;
+        }
+        Scintilla::Position q = p;
+        while (q < end && text.at(q) != '\t') ++q;
+        cpAnchor = p;
+        cpCaret  = q;
+        return;
+    }
+    const int sx = data.sci.PointXFromPosition(start);
+    const int ex = data.sci.PointXFromPosition(end);
+    auto place = [&](int px, Scintilla::Position& cp, Scintilla::Position& vs) {
+        px += sx;
+        if (px < ex) cp = data.positionFromLineAndPointX(line, px);
+        else {
+            cp = end;
+            vs = blankCount(px - ex);
+        }
+    };
+    place(_region.left , cpAnchor, vsAnchor);
+    place(_region.right, cpCaret , vsCaret );
+}
+
+
 RectangularSelection& RectangularSelection::extend() {
 
     if (_mode == Scintilla::SelectionMode::Rectangle || _mode == Scintilla::SelectionMode::Thin) {
@@ -335,11 +507,8 @@ RectangularSelection& RectangularSelection::extend() {
                 _caret.px = 0;
             }
         }
-        data.sci.SetRectangularSelectionAnchor            (_anchor.cp);
-        data.sci.SetRectangularSelectionAnchorVirtualSpace(_anchor.vs);
-        data.sci.SetRectangularSelectionCaret             (_caret.cp );
-        data.sci.SetRectangularSelectionCaretVirtualSpace (_caret.vs );
         _mode = Scintilla::SelectionMode::Rectangle;
+        select();
         return *this;
     }
 
@@ -380,12 +549,9 @@ RectangularSelection& RectangularSelection::extend() {
         _anchor = corner(anchor, 0);
         _caret  = corner(caret, caretVS);
         if (ddp) data.setTabstops(*ddp, first, last);
-        data.sci.SetRectangularSelectionAnchor(_anchor.cp);
-        data.sci.SetRectangularSelectionAnchorVirtualSpace(_anchor.vs);
-        data.sci.SetRectangularSelectionCaret(_caret.cp);
-        data.sci.SetRectangularSelectionCaretVirtualSpace(_caret.vs);
         _mode = Scintilla::SelectionMode::Rectangle;
         _reverse = false;
+        select();
         return *this;
     }
 
@@ -484,11 +650,8 @@ RectangularSelection& RectangularSelection::extend() {
         _mode    = Scintilla::SelectionMode::Rectangle;
         _anchor  = anchor;
         _caret   = caret;
-        _reverse = _anchor.ln > _caret.ln;;
-        data.sci.SetRectangularSelectionAnchor(_anchor.cp);
-        data.sci.SetRectangularSelectionAnchorVirtualSpace(_anchor.vs);
-        data.sci.SetRectangularSelectionCaret(_caret.cp);
-        data.sci.SetRectangularSelectionCaretVirtualSpace(_caret.vs);
+        _reverse = _anchor.ln > _caret.ln;
+        select();
         return *this;
     }
 
@@ -594,10 +757,7 @@ RectangularSelection& RectangularSelection::extend() {
         if (choice == 5) _caret = top;
         _anchor  = choice == 8 ? top : bottom;
         _reverse = choice == 8 ? false : true;
-        data.sci.SetRectangularSelectionAnchor            (_anchor.cp);
-        data.sci.SetRectangularSelectionAnchorVirtualSpace(_anchor.vs);
-        data.sci.SetRectangularSelectionCaret             (_caret.cp );
-        data.sci.SetRectangularSelectionCaretVirtualSpace (_caret.vs );
+        select();
         return *this;
     }
 
@@ -664,13 +824,10 @@ RectangularSelection& RectangularSelection::extend() {
         _anchor.px = pxEOL - _anchor.sx + blankWidth(_anchor.vs);
     }
 
-    data.sci.SetRectangularSelectionAnchor            (_anchor.cp);
-    data.sci.SetRectangularSelectionAnchorVirtualSpace(_anchor.vs);
-    data.sci.SetRectangularSelectionCaret             (_caret.cp );
-    data.sci.SetRectangularSelectionCaretVirtualSpace (_caret.vs );
     _mode = Scintilla::SelectionMode::Rectangle;
     _size = static_cast<int>(size);
     _reverse = _anchor.ln > _caret.ln;
+    select();
     return *this;
 
 }
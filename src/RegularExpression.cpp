@@ -23,6 +23,10 @@
 #include "RegularExpression.h"
 #include "Unicode\UnicodeRegexTraits.h"
 #include <mbstring.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
 
 
 namespace utf8byte {
@@ -134,6 +138,340 @@ std::string utf32to8(const std::basic_string_view<char32_t> u) {
 }
 
 
+// LiteralPrefilter finds a literal string which every match of a regular expression must contain, so that a search can skip
+// directly to text where a match is possible before running the regular expression, which must decode the document one code
+// point at a time.  The analysis is conservative: when the pattern contains anything it does not fully understand, or anything
+// which depends on where the search begins, no literal is used and searches run the regular expression unchanged.
+//
+// If the literal is a prefix (every match begins with it), each occurrence is tried as an anchored match in turn.  If not, and
+// the pattern cannot match a line ending, the regular expression is run only on lines containing the literal; otherwise the
+// literal is used only to determine that there can be no match.
+
+class LiteralPrefilter {
+
+    std::string literal;                     // in the document encoding; lower case ASCII when ignoring case
+    bool        ignoreCase = false;
+    bool        prefix     = false;
+    bool        singleLine = false;
+    intptr_t    skip[256];                   // Boyer-Moore-Horspool shift for the byte aligned with the end of the literal
+
+    static char fold(char c) { return c >= 'A' && c <= 'Z' ? c | 0x20 : c; }
+
+    // Returns the offset of the first occurrence of the literal in the n bytes at s, or -1 if there is none.
+
+    intptr_t scan(const char* s, intptr_t n) const {
+        const intptr_t m = literal.length();
+        if (m == 1 && !ignoreCase) {
+            const void* found = memchr(s, literal[0], n);
+            return found ? static_cast<const char*>(found) - s : -1;
+        }
+        for (intptr_t i = 0; i + m <= n; i += skip[static_cast<unsigned char>(s[i + m - 1])]) {
+            intptr_t k = m - 1;
+            if (ignoreCase) while (k >= 0 && fold(s[i + k]) == literal[k]) --k;
+                       else while (k >= 0 &&      s[i + k]  == literal[k]) --k;
+            if (k < 0) return i;
+        }
+        return -1;
+    }
+
+    // Returns the position of the first occurrence of the literal which begins at or after from and ends at or before to,
+    // or -1 if there is none.
+
+    intptr_t find(const char* pt1, const char* pt2, intptr_t gap, intptr_t from, intptr_t to) const {
+        const intptr_t m = literal.length();
+        if (to - from < m) return -1;
+        if (from < gap) {
+            const intptr_t stop = std::min(gap, to);
+            const intptr_t p    = scan(pt1 + from, stop - from);
+            if (p >= 0) return from + p;
+            if (stop == to) return -1;
+            const intptr_t s1 = std::max(from, gap - m + 1);
+            const intptr_t s2 = std::min(to, gap + m - 1);
+            std::string straddle;
+            for (intptr_t i = s1; i < s2; ++i) straddle += i < gap ? pt1[i] : pt2[i];
+            const intptr_t q = scan(straddle.data(), straddle.length());
+            if (q >= 0) return s1 + q;
+            from = gap;
+        }
+        const intptr_t p = scan(pt2 + from, to - from);
+        return p < 0 ? -1 : from + p;
+    }
+
+public:
+
+    bool active() const { return !literal.empty(); }
+
+    // Analyze a pattern as it will be compiled; utf8 indicates the document encoding is utf-8, otherwise only ASCII literals
+    // can be used, and dbcs indicates a double-byte encoding, in which a byte match might begin within a character.
+
+    void analyze(const std::wstring& pattern, bool caseSensitive, bool utf8, bool dbcs) {
+        literal.clear();
+        ignoreCase = !caseSensitive;
+        singleLine = true;
+        const std::basic_string<char32_t> p = utf16to32(pattern);
+        const size_t n = p.length();
+        std::basic_string<char32_t> run, first, best;
+        bool usable     = true;
+        bool prefixOpen = true;              // run began at the start of every match
+        bool lastInRun  = false;             // the last atom was a character appended to run
+        int  depth      = 0;
+        auto endRun = [&]() {
+            if (prefixOpen) first = run;
+            if (run.length() > best.length()) best = run;
+            run.clear();
+            prefixOpen = lastInRun = false;
+        };
+        auto zeroWidth = [&]() { if (!prefixOpen || !run.empty()) endRun(); };
+        auto character = [&](char32_t c) {
+            if (c == '\n' || c == '\r') singleLine = false;
+            if (depth > 0) lastInRun = false;
+            else if (c == '\n' || c == '\r' || (c >= 0xD800 && c <= 0xDFFF) || (!utf8 && c >= 0x80)
+                  || (ignoreCase && (c >= 0x80 || c == 'k' || c == 'K' || c == 's' || c == 'S'))) endRun();
+            else {
+                run += c;
+                lastInRun = true;
+            }
+        };
+        auto skipBraces = [&](size_t& i, char32_t open, char32_t close) {
+            if (i + 1 < n && p[i + 1] == open) {
+                const size_t j = p.find(close, i + 2);
+                if (j == std::string::npos) usable = false;
+                else i = j;
+                return true;
+            }
+            return false;
+        };
+        for (size_t i = 0; usable && i < n; ++i) {
+            const char32_t c = p[i];
+            switch (c) {
+            case '\\':
+            {
+                if (++i >= n) {
+                    usable = false;
+                    break;
+                }
+                const char32_t e = p[i];
+                if (e >= 0x80 || (e > 0x20 && e < 0x7F && !isalnum(static_cast<int>(e)))) character(e);
+                else if (e == 't') character('\t');
+                else if (e == 'b' || e == 'B' || e == '<' || e == '>') zeroWidth();
+                else if (e == 'd' || e == 'w' || e == 'h' || (e >= '1' && e <= '9')) endRun();
+                else if (wcschr(L"GAzZ`'KQE", static_cast<wchar_t>(e))) usable = false;
+                else {
+                    if      (e == 'x') { if (!skipBraces(i, '{', '}')) for (int k = 0; k < 2 && i + 1 < n && p[i + 1] < 0x80 && isxdigit(static_cast<int>(p[i + 1])); ++k) ++i; }
+                    else if (e == 'p' || e == 'P' || e == 'N') { if (!skipBraces(i, '{', '}') && i + 1 < n) ++i; }
+                    else if (e == 'c') { if (i + 1 < n) ++i; }
+                    else if (e == 'o') skipBraces(i, '{', '}');
+                    else if (e == '0') for (int k = 0; k < 3 && i + 1 < n && p[i + 1] >= '0' && p[i + 1] <= '7'; ++k) ++i;
+                    else if (e == 'g') { if (!skipBraces(i, '{', '}')) while (i + 1 < n && (p[i + 1] == '-' || (p[i + 1] >= '0' && p[i + 1] <= '9'))) ++i; }
+                    else if (e == 'k') { if (!skipBraces(i, '<', '>') && !skipBraces(i, '{', '}')) skipBraces(i, '\'', '\''); }
+                    endRun();
+                    singleLine = false;
+                }
+                break;
+            }
+            case '[':
+            {
+                size_t j = i + 1;
+                if (j < n && p[j] == '^') {
+                    singleLine = false;
+                    ++j;
+                }
+                for (bool firstItem = true;; ++j, firstItem = false) {
+                    if (j >= n) {
+                        usable = false;
+                        break;
+                    }
+                    char32_t lo = p[j];
+                    if (lo == ']' && !firstItem) break;
+                    if (lo == '[' && j + 1 < n && (p[j + 1] == ':' || p[j + 1] == '.' || p[j + 1] == '=')) {
+                        const char32_t closing[] = { p[j + 1], ']', 0 };
+                        j = p.find(closing, j + 2);
+                        if (j == std::string::npos) usable = false;
+                        else ++j;
+                        singleLine = false;
+                        if (!usable) break;
+                        continue;
+                    }
+                    if (lo == '\\') {
+                        if (++j >= n) {
+                            usable = false;
+                            break;
+                        }
+                        lo = p[j];
+                        if (lo == 'd' || lo == 'w' || lo == 'h') continue;
+                        if (lo == 't') lo = '\t';
+                        else if (lo < 0x80 && (lo <= 0x20 || isalnum(static_cast<int>(lo)))) singleLine = false;
+                    }
+                    if (j + 2 < n && p[j + 1] == '-' && p[j + 2] != ']') {
+                        j += 2;
+                        if (p[j] == '\\') {
+                            singleLine = false;
+                            ++j;
+                        }
+                        else if (lo <= '\r' && p[j] >= '\n') singleLine = false;
+                    }
+                    else if (lo == '\n' || lo == '\r') singleLine = false;
+                }
+                i = j;
+                endRun();
+                break;
+            }
+            case '(':
+                if (i + 1 < n && p[i + 1] == '*') usable = false;
+                else if (i + 2 < n && p[i + 1] == '?' && !wcschr(L":=!<>|", static_cast<wchar_t>(p[i + 2]))) usable = false;
+                endRun();
+                ++depth;
+                break;
+            case ')':
+                if (depth > 0) --depth;
+                lastInRun = false;
+                break;
+            case '|':
+                if (depth == 0) usable = false;
+                break;
+            case '.':
+                endRun();
+                break;
+            case '^':
+            case '$':
+                zeroWidth();
+                break;
+            case '*':
+            case '+':
+            case '?':
+            case '{':
+            {
+                bool optional = c != '+';
+                if (c == '{') {
+                    const size_t j = p.find('}', i + 1);
+                    if (j == std::string::npos || j == i + 1
+                     || p.find_first_not_of(U"0123456789,", i + 1) < j || p[i + 1] == ',') {
+                        character(c);
+                        break;
+                    }
+                    optional = p[i + 1] == '0' && (p[i + 2] == ',' || p[i + 2] == '}');
+                    i = j;
+                }
+                if (lastInRun) {
+                    if (optional) run.pop_back();
+                    endRun();
+                }
+                if (i + 1 < n && (p[i + 1] == '?' || p[i + 1] == '+')) ++i;
+                break;
+            }
+            default:
+                character(c);
+            }
+        }
+        if (!usable) return;
+        endRun();
+        const bool usePrefix = !first.empty() && (first.length() >= 3 || first.length() >= best.length());
+        const std::basic_string<char32_t>& chosen = usePrefix ? first : best;
+        prefix = usePrefix && !dbcs;
+        if (utf8) literal = utf32to8(chosen);
+        else for (char32_t c : chosen) literal += static_cast<char>(c);
+        if (ignoreCase) for (char& c : literal) c = fold(c);
+        const intptr_t m = literal.length();
+        for (intptr_t& s : skip) s = m;
+        for (intptr_t k = 0; k < m - 1; ++k) {
+            const unsigned char b = literal[k];
+            skip[b] = m - 1 - k;
+            if (ignoreCase && b >= 'a' && b <= 'z') skip[b & ~0x20] = m - 1 - k;
+        }
+    }
+
+    // Search for a match between from and to, calling attempt(from, to, anchored) to run the regular expression only where the
+    // literal makes a match possible; returns false without calling attempt when the literal does not occur.
+
+    template<typename Attempt> bool search(const char* pt1, const char* pt2, intptr_t gap, intptr_t from, intptr_t to, Attempt attempt) const {
+        auto at = [&](intptr_t i) { return i < gap ? pt1[i] : pt2[i]; };
+        while (from < to) {
+            const intptr_t q = find(pt1, pt2, gap, from, to);
+            if (q < 0) return false;
+            if (prefix) {
+                if (attempt(q, to, true)) return true;
+                from = q + 1;
+            }
+            else if (singleLine) {
+                intptr_t lineStart = q;
+                while (lineStart > from && at(lineStart - 1) != '\n' && at(lineStart - 1) != '\r') --lineStart;
+                intptr_t lineEnd = q + static_cast<intptr_t>(literal.length());
+                while (lineEnd < to && at(lineEnd) != '\n' && at(lineEnd) != '\r') ++lineEnd;
+                if (attempt(lineStart, lineEnd, false)) return true;
+                from = lineEnd;
+            }
+            else return attempt(from, to, false);
+        }
+        return false;
+    }
+
+};
+
+
+// Compiled regular expressions are kept in a small cache shared by all commands, so that repeating a search (as when pressing
+// Find Next) or using the same expression again in another command does not compile it again.  The encoding class is part of
+// the key because the literal prefilter depends on it; the compiled expression itself does not.
+
+enum class EncodingClass { sbcs, utf8, dbcs };
+
+struct CompiledExpression {
+    boost::basic_regex<char32_t, utf32_regex_traits> regex;
+    LiteralPrefilter                                 prefilter;
+};
+
+class CompiledExpressionCache {
+    struct Entry {
+        uint64_t                                  lastUsed;
+        std::shared_ptr<const CompiledExpression> compiled;
+    };
+    std::map<std::tuple<std::wstring, bool, EncodingClass>, Entry> entries;
+    std::mutex mutex;
+    uint64_t   useCount = 0;
+    size_t     hits     = 0;
+    size_t     misses   = 0;
+public:
+    static constexpr size_t maximumEntries = 32;
+
+    size_t hitCount () { const std::lock_guard<std::mutex> lock(mutex); return hits  ; }
+    size_t missCount() { const std::lock_guard<std::mutex> lock(mutex); return misses; }
+
+    // Returns the compiled expression, or a null pointer with a message in error if the pattern cannot be compiled.
+
+    std::shared_ptr<const CompiledExpression> get(const std::wstring& pattern, bool caseSensitive, EncodingClass encoding, std::wstring& error) {
+        const std::lock_guard<std::mutex> lock(mutex);
+        const auto key = std::make_tuple(pattern, caseSensitive, encoding);
+        if (auto entry = entries.find(key); entry != entries.end()) {
+            entry->second.lastUsed = ++useCount;
+            ++hits;
+            return entry->second.compiled;
+        }
+        ++misses;
+        auto compiled = std::make_shared<CompiledExpression>();
+        try {
+            compiled->regex.assign(utf16to32(pattern), (caseSensitive ? boost::regex_constants::normal : boost::regex_constants::icase));
+        }
+        catch (const boost::regex_error& e) {
+            error = toWide(e.what(), CP_UTF8);
+            return nullptr;
+        }
+        catch (...) {
+            error = L"Undetermined error processing this regular expression.";
+            return nullptr;
+        }
+        compiled->prefilter.analyze(pattern, caseSensitive, encoding == EncodingClass::utf8, encoding == EncodingClass::dbcs);
+        if (entries.size() >= maximumEntries) {
+            auto oldest = entries.begin();
+            for (auto i = entries.begin(); i != entries.end(); ++i) if (i->second.lastUsed < oldest->second.lastUsed) oldest = i;
+            entries.erase(oldest);
+        }
+        entries[key] = { ++useCount, compiled };
+        return compiled;
+    }
+};
+
+static CompiledExpressionCache compiledExpressions;
+
+
 class RegularExpressionU : public RegularExpressionInterface {
 
 public:
@@ -145,6 +483,7 @@ public:
         intptr_t    gap;
         const char* pt1;
         const char* pt2;
+        bool        ascii;  // the text searched is all ASCII, so each byte is a character and nothing need be decoded
 
         char at(intptr_t cp) const { return cp < gap ? pt1[cp] : pt2[cp]; }
 
@@ -176,7 +515,7 @@ public:
         // after being incremented and decremented, which can break the regular expression algorithm.
 
         void fix_position() {
-            if (pos <= 0 || pos >= end || !utf8byte::isTrail(at(pos)) || utf8byte::isASCII(at(pos - 1))) return;
+            if (ascii || pos <= 0 || pos >= end || !utf8byte::isTrail(at(pos)) || utf8byte::isASCII(at(pos - 1))) return;
             int n = length(pos - 1);
             if (n > 1) pos += n - 1;
             else if (pos > 1) {
@@ -197,9 +536,9 @@ public:
         using pointer           = char32_t*;
         using reference         = char32_t&;
 
-        DocumentIterator() : pos(0), end(0), gap(0), pt1(0), pt2(0) {}
-        DocumentIterator(RegularExpressionU*     reba, intptr_t pos) : pos(pos), end(reba->end), gap(reba->gap), pt1(reba->pt1), pt2(reba->pt2) { fix_position(); }
-        DocumentIterator(const DocumentIterator& di  , intptr_t pos) : pos(pos), end(di.end   ), gap(di.gap   ), pt1(di.pt1   ), pt2(di.pt2   ) { fix_position(); }
+        DocumentIterator() : pos(0), end(0), gap(0), pt1(0), pt2(0), ascii(false) {}
+        DocumentIterator(RegularExpressionU*     reba, intptr_t pos) : pos(pos), end(reba->end), gap(reba->gap), pt1(reba->pt1), pt2(reba->pt2), ascii(reba->ascii) { fix_position(); }
+        DocumentIterator(const DocumentIterator& di  , intptr_t pos) : pos(pos), end(di.end   ), gap(di.gap   ), pt1(di.pt1   ), pt2(di.pt2   ), ascii(di.ascii   ) { fix_position(); }
 
         bool operator==(const DocumentIterator& other) const { return pos == other.pos; }
         bool operator!=(const DocumentIterator& other) const { return pos != other.pos; }
@@ -208,12 +547,12 @@ public:
         DocumentIterator& position(Scintilla::Position at) { pos = at; return *this; }
 
         DocumentIterator& operator++() {
-            pos += length(pos);
+            pos += ascii ? 1 : length(pos);
             return *this;
         }
 
         DocumentIterator& operator--() {
-            if      (!utf8byte::isTrail(at(pos - 1))) --pos;
+            if      (ascii || !utf8byte::isTrail(at(pos - 1))) --pos;
             else if (pos < 2              ) --pos;
             else if (length(pos - 2) == 2 ) pos -= 2;
             else if (pos < 3              ) --pos;
@@ -226,7 +565,7 @@ public:
 
         char32_t operator*() const {
             unsigned char c1 = at(pos);
-            if (utf8byte::isASCII(c1)) return c1;
+            if (ascii || utf8byte::isASCII(c1)) return c1;
             int n = length(pos);
             return n == 2 ? utf8byte::to32(c1, at(pos + 1))
                  : n == 3 ? utf8byte::to32(c1, at(pos + 1), at(pos + 2))
@@ -245,11 +584,62 @@ private:
     const char* pt1 = 0;
     const char* pt2 = 0;
 
+    bool        ascii     = false;           // the text from the search start to the search end is all ASCII
+    intptr_t    asciiFrom = 0;               // the text from asciiFrom to asciiTo is known to be all ASCII
+    intptr_t    asciiTo   = 0;
+    intptr_t    nonAscii  = -1;              // the position of a byte known not to be ASCII, or -1
+
     Scintilla::ScintillaCall&                        sci;
-    boost::basic_regex<char32_t, utf32_regex_traits> uFind;
+    std::shared_ptr<const CompiledExpression>        compiled;
     boost::match_results<DocumentIterator>           uMatch;
     bool                                             regexValid = false;
 
+    // Returns the position of the first byte which is not ASCII at or after from and before to, or to if there is none.
+
+    intptr_t findNonAscii(intptr_t from, intptr_t to) const {
+        while (from < to) {
+            const char*    s     = from < gap ? pt1 + from : pt2 + from;
+            const intptr_t limit = from < gap ? std::min(gap, to) : to;
+            for (; from + 8 <= limit; from += 8, s += 8) {
+                uint64_t word;
+                memcpy(&word, s, 8);
+                if (word & 0x8080808080808080ULL) break;
+            }
+            for (; from < limit; ++from, ++s) if (!utf8byte::isASCII(*s)) return from;
+        }
+        return to;
+    }
+
+    // Determines whether the text from from to to is all ASCII, scanning only the part not already known.
+
+    bool isAscii(intptr_t from, intptr_t to) {
+        if (nonAscii >= from && nonAscii < to) return false;
+        if (from >= asciiFrom && to <= asciiTo) return true;
+        if (to < asciiFrom || from > asciiTo) asciiFrom = asciiTo = from;
+        if (from < asciiFrom) {
+            const intptr_t p = findNonAscii(from, asciiFrom);
+            if (p < asciiFrom) {
+                nonAscii = p;
+                return false;
+            }
+            asciiFrom = from;
+        }
+        if (to > asciiTo) {
+            const intptr_t p = findNonAscii(asciiTo, to);
+            asciiTo = p;
+            if (p < to) {
+                nonAscii = p;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void resetAscii() {
+        asciiFrom = asciiTo = 0;
+        nonAscii  = -1;
+    }
+
 public:
 
     RegularExpressionU(Scintilla::ScintillaCall& sci) : sci(sci) {}
@@ -257,19 +647,10 @@ public:
     bool can_search() const override { return regexValid; }
 
     std::wstring find(const std::wstring& s, bool caseSensitive) override {
-        try {
-            uFind.assign(utf16to32(s), (caseSensitive ? boost::regex_constants::normal : boost::regex_constants::icase));
-        }
-        catch (const boost::regex_error& e) {
-            regexValid = false;
-            return toWide(e.what(), CP_UTF8);
-        }
-        catch (...) {
-            regexValid = false;
-            return L"Undetermined error processing this regular expression.";
-        }
-        regexValid = true;
-        return L"";
+        std::wstring error;
+        compiled   = compiledExpressions.get(s, caseSensitive, EncodingClass::utf8, error);
+        regexValid = !!compiled;
+        return error;
     }
 
     std::string format(const std::string& replacement) const override {
@@ -279,13 +660,14 @@ public:
     void invalidate() override {
         end = gap = 0;
         pt1 = pt2 = 0;
+        resetAscii();
     }
 
     intptr_t length(int n = 0) const override {
         return uMatch.empty() || n < 0 || n >= static_cast<int>(uMatch.size()) ? -1 : uMatch[n].second.position() - uMatch[n].first.position();
     }
 
-    size_t mark_count() const override { return !regexValid ? 0 : uFind.mark_count(); }
+    size_t mark_count() const override { return !regexValid ? 0 : compiled->regex.mark_count(); }
 
     intptr_t position(int n = 0) const override { return uMatch.empty() || n < 0 || n >= static_cast<int>(uMatch.size()) ? -1 : uMatch[n].first.position(); }
 
@@ -294,8 +676,10 @@ public:
         end = gap = s.length();
         pt1 = s.data();
         pt2 = 0;
+        resetAscii();
+        ascii = isAscii(0, s.length());
         try {
-            return boost::regex_search(DocumentIterator(this, from), DocumentIterator(this, s.length()), uMatch, uFind,
+            return boost::regex_search(DocumentIterator(this, from), DocumentIterator(this, s.length()), uMatch, compiled->regex,
                                        boost::match_not_dot_newline, DocumentIterator(this, 0));
         }
         catch (const boost::regex_error& e) {
@@ -316,9 +700,17 @@ public:
             pt1 = gap > 0   ? reinterpret_cast<const char*>(sci.RangePointer(0  , gap      ))       : 0;
             pt2 = gap < end ? reinterpret_cast<const char*>(sci.RangePointer(gap, end - gap)) - gap : 0;
         }
+        ascii = isAscii(start, to);
         try {
-            return boost::regex_search(DocumentIterator(this, from), DocumentIterator(this, to), uMatch, uFind,
-                                       boost::match_not_dot_newline, DocumentIterator(this, start));
+            auto attempt = [&](intptr_t first, intptr_t last, bool anchored) {
+                return boost::regex_search(DocumentIterator(this, first), DocumentIterator(this, last), uMatch, compiled->regex,
+                                           anchored ? boost::match_not_dot_newline | boost::match_continuous : boost::match_not_dot_newline,
+                                           DocumentIterator(this, start));
+            };
+            if (!compiled->prefilter.active()) return attempt(from, to, false);
+            if (compiled->prefilter.search(pt1, pt2, gap, from, to, attempt)) return true;
+            uMatch = boost::match_results<DocumentIterator>();
+            return false;
         }
         catch (const boost::regex_error& e) {
             MessageBox(0, toWide(e.what(), 0).data(), L"Columns++: Error in regular expression search", MB_ICONERROR);
@@ -330,6 +722,17 @@ public:
         return false;
     }
 
+    // Search the given text, which must remain valid until invalidate is called, instead of the Scintilla document;
+    // this makes it possible to search from a thread other than the one that owns the Scintilla control
+
+    void set_text(const char* text1, const char* text2, intptr_t gapPosition, intptr_t length) override {
+        pt1 = text1;
+        pt2 = text2;
+        gap = gapPosition;
+        end = length;
+        resetAscii();
+    }
+
     size_t size() const override { return uMatch.size(); }
 
     std::string str(int n) const override {
@@ -423,7 +826,7 @@ private:
     const char* pt2 = 0;
 
     Scintilla::ScintillaCall&                        sci;
-    boost::basic_regex<char32_t, utf32_regex_traits> uFind;
+    std::shared_ptr<const CompiledExpression>        compiled;
     boost::match_results<DocumentIterator>           uMatch;
     bool                                             regexValid = false;
 
@@ -434,19 +837,10 @@ public:
     bool can_search() const override { return regexValid; }
 
     std::wstring find(const std::wstring& s, bool caseSensitive) override {
-        try {
-            uFind.assign(utf16to32(s), (caseSensitive ? boost::regex_constants::normal : boost::regex_constants::icase));
-        }
-        catch (const boost::regex_error& e) {
-            regexValid = false;
-            return toWide(e.what(), CP_UTF8);
-        }
-        catch (...) {
-            regexValid = false;
-            return L"Undetermined error processing this regular expression.";
-        }
-        regexValid = true;
-        return L"";
+        std::wstring error;
+        compiled   = compiledExpressions.get(s, caseSensitive, EncodingClass::sbcs, error);
+        regexValid = !!compiled;
+        return error;
     }
 
     std::string format(const std::string& replacement) const override {
@@ -462,7 +856,7 @@ public:
         return uMatch.empty() || n < 0 || n >= static_cast<int>(uMatch.size()) ? -1 : uMatch[n].second.position() - uMatch[n].first.position();
     }
 
-    size_t mark_count() const override { return !regexValid ? 0 : uFind.mark_count(); }
+    size_t mark_count() const override { return !regexValid ? 0 : compiled->regex.mark_count(); }
 
     intptr_t position(int n = 0) const override { return uMatch.empty() || n < 0 || n >= static_cast<int>(uMatch.size()) ? -1 : uMatch[n].first.position(); }
 
@@ -472,7 +866,7 @@ public:
         pt1 = s.data();
         pt2 = 0;
         try {
-            return boost::regex_search(DocumentIterator(this, from), DocumentIterator(this, s.length()), uMatch, uFind,
+            return boost::regex_search(DocumentIterator(this, from), DocumentIterator(this, s.length()), uMatch, compiled->regex,
                                        boost::match_not_dot_newline, DocumentIterator(this, 0));
         }
         catch (const boost::regex_error& e) {
@@ -494,8 +888,15 @@ public:
             pt2 = gap < end ? reinterpret_cast<const char*>(sci.RangePointer(gap, end - gap)) - gap : 0;
         }
         try {
-            return boost::regex_search(DocumentIterator(this, from), DocumentIterator(this, to), uMatch, uFind,
-                                       boost::match_not_dot_newline, DocumentIterator(this, start));
+            auto attempt = [&](intptr_t first, intptr_t last, bool anchored) {
+                return boost::regex_search(DocumentIterator(this, first), DocumentIterator(this, last), uMatch, compiled->regex,
+                                           anchored ? boost::match_not_dot_newline | boost::match_continuous : boost::match_not_dot_newline,
+                                           DocumentIterator(this, start));
+            };
+            if (!compiled->prefilter.active()) return attempt(from, to, false);
+            if (compiled->prefilter.search(pt1, pt2, gap, from, to, attempt)) return true;
+            uMatch = boost::match_results<DocumentIterator>();
+            return false;
         }
         catch (const boost::regex_error& e) {
             MessageBox(0, toWide(e.what(), 0).data(), L"Columns++: Error in regular expression search", MB_ICONERROR);
@@ -507,6 +908,13 @@ public:
         return false;
     }
 
+    void set_text(const char* text1, const char* text2, intptr_t gapPosition, intptr_t length) override {
+        pt1 = text1;
+        pt2 = text2;
+        gap = gapPosition;
+        end = length;
+    }
+
     size_t size() const override { return uMatch.size(); }
 
     std::string str(int n) const override {
@@ -646,7 +1054,7 @@ private:
     const char* pt2 = 0;
 
     Scintilla::ScintillaCall&                        sci;
-    boost::basic_regex<char32_t, utf32_regex_traits> uFind;
+    std::shared_ptr<const CompiledExpression>        compiled;
     boost::match_results<DocumentIterator>           uMatch;
     bool                                             regexValid = false;
 
@@ -657,19 +1065,10 @@ public:
     bool can_search() const override { return regexValid; }
 
     std::wstring find(const std::wstring& s, bool caseSensitive) override {
-        try {
-            uFind.assign(utf16to32(s), (caseSensitive ? boost::regex_constants::normal : boost::regex_constants::icase));
-        }
-        catch (const boost::regex_error& e) {
-            regexValid = false;
-            return toWide(e.what(), CP_UTF8);
-        }
-        catch (...) {
-            regexValid = false;
-            return L"Undetermined error processing this regular expression.";
-        }
-        regexValid = true;
-        return L"";
+        std::wstring error;
+        compiled   = compiledExpressions.get(s, caseSensitive, EncodingClass::dbcs, error);
+        regexValid = !!compiled;
+        return error;
     }
 
     std::string format(const std::string& replacement) const override {
@@ -685,7 +1084,7 @@ public:
         return uMatch.empty() || n < 0 || n >= static_cast<int>(uMatch.size()) ? -1 : uMatch[n].second.position() - uMatch[n].first.position();
     }
 
-    size_t mark_count() const override { return !regexValid ? 0 : uFind.mark_count(); }
+    size_t mark_count() const override { return !regexValid ? 0 : compiled->regex.mark_count(); }
 
     intptr_t position(int n = 0) const override { return uMatch.empty() || n < 0 || n >= static_cast<int>(uMatch.size()) ? -1 : uMatch[n].first.position(); }
 
@@ -695,7 +1094,7 @@ public:
         pt1 = s.data();
         pt2 = 0;
         try {
-            return boost::regex_search(DocumentIterator(this, from), DocumentIterator(this, s.length()), uMatch, uFind,
+            return boost::regex_search(DocumentIterator(this, from), DocumentIterator(this, s.length()), uMatch, compiled->regex,
                                        boost::match_not_dot_newline, DocumentIterator(this, 0));
         }
         catch (const boost::regex_error& e) {
@@ -717,8 +1116,15 @@ public:
             pt2 = gap < end ? reinterpret_cast<const char*>(sci.RangePointer(gap, end - gap)) - gap : 0;
         }
         try {
-            return boost::regex_search(DocumentIterator(this, from), DocumentIterator(this, to), uMatch, uFind,
-                                       boost::match_not_dot_newline, DocumentIterator(this, start));
+            auto attempt = [&](intptr_t first, intptr_t last, bool anchored) {
+                return boost::regex_search(DocumentIterator(this, first), DocumentIterator(this, last), uMatch, compiled->regex,
+                                           anchored ? boost::match_not_dot_newline | boost::match_continuous : boost::match_not_dot_newline,
+                                           DocumentIterator(this, start));
+            };
+            if (!compiled->prefilter.active()) return attempt(from, to, false);
+            if (compiled->prefilter.search(pt1, pt2, gap, from, to, attempt)) return true;
+            uMatch = boost::match_results<DocumentIterator>();
+            return false;
         }
         catch (const boost::regex_error& e) {
             MessageBox(0, toWide(e.what(), 0).data(), L"Columns++: Error in regular expression search", MB_ICONERROR);
@@ -730,6 +1136,13 @@ public:
         return false;
     }
 
+    void set_text(const char* text1, const char* text2, intptr_t gapPosition, intptr_t length) override {
+        pt1 = text1;
+        pt2 = text2;
+        gap = gapPosition;
+        end = length;
+    }
+
     size_t size() const override { return uMatch.size(); }
 
     std::string str(int n) const override {
@@ -769,3 +1182,6 @@ RegularExpression::RegularExpression(Scintilla::ScintillaCall& sci) {
         rex = new RegularExpressionDBCS(sci);
     }
 }
+
+size_t RegularExpression::cacheHits  () { return compiledExpressions.hitCount (); }
+size_t RegularExpression::cacheMisses() { return compiledExpressions.missCount(); }
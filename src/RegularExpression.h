@@ -35,6 +35,7 @@ public:
     virtual intptr_t     position  (int n = 0                                        ) const = 0;
     virtual bool         search    (std::string_view s, size_t from = 0              )       = 0;
     virtual bool         search    (intptr_t from, intptr_t to, intptr_t start       )       = 0;
+    virtual void         set_text  (const char* pt1, const char* pt2, intptr_t gap, intptr_t end) = 0;
     virtual size_t       size      (                                                 ) const = 0;
     virtual std::string  str       (int n = 0                                        ) const = 0;
     virtual std::string  str       (std::string_view n                               ) const = 0;
@@ -54,7 +55,10 @@ public:
     intptr_t     position  (int n = 0                                        ) const {return rex->position  (n               );}
     bool         search    (std::string_view s, size_t from = 0              )       {return rex->search    (s, from         );}
     bool         search    (intptr_t from, intptr_t to, intptr_t start       )       {return rex->search    (from, to, start );}
+    void         set_text  (const char* pt1, const char* pt2, intptr_t gap, intptr_t end) {rex->set_text(pt1, pt2, gap, end);}
     size_t       size      (                                                 ) const {return rex->size      (                );}
     std::string  str       (int n = 0                                        ) const {return rex->str       (n               );}
     std::string  str       (std::string_view n                               ) const {return rex->str       (n               );}
+    static size_t cacheHits  ();  // compiled regular expressions reused from the cache
+    static size_t cacheMisses();  // regular expressions compiled
 };
@@ -16,9 +16,11 @@
 
 #include "ColumnsPlusPlus.h"
 #include "RegularExpression.h"
+#include <atomic>
 #include <format>
 #include <regex>
 #include <string.h>
+#include <thread>
 #include "commctrl.h"
 #include "resource.h"
 #include "Search.h"
@@ -44,15 +46,53 @@ namespace {
         Scintilla::Position position;
 
         Scintilla::Position nullAt       = -1;     // used when expression contains \K to recognize non-advancing null matches
+        Scintilla::Position firstChange  = -1;     // start of the first replacement made, or -1 if none
+        Scintilla::Position lastChange   = -1;     // end of the last replacement made
         intptr_t            count        = 0;
         bool                timerStarted = false;
 
+        // Replacements within one search region are collected in batch and applied with a single ReplaceTarget when the search
+        // leaves the region, the batch grows beyond batchLimit, or the batch would reach a line with a marker; until then the document
+        // is unchanged, so positions are those of the original text.  Batching is used only when no match could depend on text
+        // before the point where its search starts.
+
+        static constexpr size_t batchLimit = 1 << 20;
+        std::string         batch;                 // text to replace the document from batchStart to batchEnd
+        DocumentSnapshot    batchText;             // the document text from which unmatched text between matches is copied
+        Scintilla::Position batchStart = -1;       // start of the text to be replaced, or -1 if no replacements are pending
+        Scintilla::Position batchEnd   = 0;        // end of the last match added to the batch
+        Scintilla::Line     batchMarker = -1;      // first line after the line of batchStart which has a marker, or -1 if none
+        bool                batching   = false;    // replacements may be collected; if false, each is applied as it is found
+
+        // Parallel counting (see startParallelCounting) divides the search regions into pieces, which worker threads search a round
+        // at a time; the results of each round are merged on this thread before the next round begins.
+
+        struct CountPiece {
+            Scintilla::Position regionStart, regionEnd;  // search region, which bounds the matches
+            Scintilla::Position from, until;            // matches beginning from here to until are found from this piece
+            Scintilla::Position bound;                  // end of the text searched for this piece: until plus an overlap, or regionEnd
+            bool                first;                  // first piece of its search region
+        };
+        struct CountFound {
+            Scintilla::Position origin;                 // position at which the search began
+            Scintilla::Position start;                  // position of the match; or, if there was no match, end of the region or until
+            Scintilla::Position length;                 // length of the match; -1 if there is no match in the region, -2 if there
+        };                                              //     is no match beginning before until, or -3 if the match reached bound
+        std::vector<CountPiece>                         countPieces;
+        std::vector<std::unique_ptr<RegularExpression>> countMatchers;
+        size_t                                          countNext = 0;  // first piece of the next round
+
         SearchProgressInfo(ColumnsPlusPlusData& data) : data(data), rx(data.sci) {}
 
         bool scCounting();
         bool rxCounting();
+        bool startParallelCounting();
+        bool rxCountingParallel();
+        static CountFound countFrom(RegularExpression& matcher, const CountPiece& piece, Scintilla::Position p);
         bool scReplacing();
         bool rxReplacing();
+        void addReplacement(Scintilla::Position found, Scintilla::Position length, const std::string& r);
+        void applyReplacements();
         void searchMultiple(bool replace, bool partial, bool before);
 
         bool (SearchProgressInfo::* task)();
@@ -708,6 +748,27 @@ bool doesRegexUseK(std::wstring_view r) {
     return r.find(L"\\K") != std::wstring::npos;  // false positives affect efficiency but not accuracy
 }
 
+bool doesRegexLookBehind(std::wstring_view r) {
+    // true if a match could depend on text before the position at which the search begins (line start, word boundary or
+    // lookbehind assertions); false positives affect efficiency but not accuracy
+    bool inClass = false;
+    for (size_t i = 0; i < r.length(); ++i) {
+        if (r[i] == L'\\') {
+            if (++i >= r.length()) break;
+            if (!inClass && wcschr(L"bBG<>", r[i])) return true;
+        }
+        else if (inClass) inClass = r[i] != L']';
+        else if (r[i] == L'[') {
+            inClass = true;
+            if (i + 1 < r.length() && r[i + 1] == L'^') ++i;
+            if (i + 1 < r.length() && r[i + 1] == L']') ++i;
+        }
+        else if (r[i] == L'^') return true;
+        else if (r.substr(i, 4) == L"(?<=" || r.substr(i, 4) == L"(?<!") return true;
+    }
+    return false;
+}
+
 std::vector<std::string> prepareReplace(ColumnsPlusPlusData& data) {
     const std::wstring& r = data.searchData.replaceHistory.back();
     UINT codepage = data.sci.CodePage();
@@ -862,6 +923,13 @@ bool convertSelectionToSearchRegion(ColumnsPlusPlusData& data) {
     if (rs.size() || (n < 2 && rs.anchor().ln == rs.caret().ln)) {
         rs.extend();
         if (!rs.size()) return false;
+        if (rs.isVirtual()) /* the rectangle was too large to select; mark its rows directly */ {
+            data.sci.SetIndicatorCurrent(data.searchData.indicator);
+            data.sci.IndicatorClearRange(0, data.sci.Length());
+            data.sci.SetIndicatorValue(1);
+            for (auto row : rs) if (row.cpMax() > row.cpMin()) data.sci.IndicatorFillRange(row.cpMin(), row.cpMax() - row.cpMin());
+            return true;
+        }
         n = data.sci.Selections();
     }
     for (int i = 0;; ++i) {
@@ -1061,8 +1129,9 @@ void ColumnsPlusPlusData::searchReplaceAll(bool partial, bool before) {
     searchData.regexCalc->clear();
     if (spi.count > 0) {
         if (settings.elasticEnabled) {
+            // The search dialog does not bypass notifications, so scnModified has already recorded the lines added or removed.
             DocumentData& dd = *getDocument();
-            analyzeTabstops(dd);
+            analyzeTabstops(dd, sci.LineFromPosition(spi.firstChange), sci.LineFromPosition(spi.lastChange), 0);
             setTabstops(dd);
         }
     }
@@ -1095,11 +1164,14 @@ void SearchProgressInfo::searchMultiple(bool replacing, bool partial, bool befor
     if (data.searchData.mode == SearchData::Regex) {
         task = replacing ? &SearchProgressInfo::rxReplacing : &SearchProgressInfo::rxCounting;
         usesK = doesRegexUseK(data.searchData.findHistory.back());
-        rx.find(data.searchData.findHistory.back(), data.searchData.matchCase);
+        batching = !usesK && !doesRegexLookBehind(data.searchData.findHistory.back());
+        if (!rx.find(data.searchData.findHistory.back(), data.searchData.matchCase).empty()) return;
+        if (!replacing && startParallelCounting()) task = &SearchProgressInfo::rxCountingParallel;
     }
     else {
         task = replacing ? &SearchProgressInfo::scReplacing : &SearchProgressInfo::scCounting;
         find = prepareFind(data);
+        batching = !data.searchData.wholeWord;
     }
 
     if (replacing) sci.BeginUndoAction();
@@ -1123,7 +1195,10 @@ void SearchProgressInfo::searchMultiple(bool replacing, bool partial, bool befor
         tickBefore = tickAfter;
     }
 
-    if (replacing) sci.EndUndoAction();
+    if (replacing) {
+        applyReplacements();
+        sci.EndUndoAction();
+    }
 
 }
 
@@ -1166,7 +1241,6 @@ bool SearchProgressInfo::rxCounting() {
         if (position >= partialEnd) return false;
     }
     Scintilla::Position indicatorEnd = sci.IndicatorEnd(searchData.indicator, position);
-    rx.invalidate();
     if (rx.search(position, indicatorEnd, start)) {
         Scintilla::Position found  = rx.position(0);
         Scintilla::Position length = rx.length();
@@ -1191,10 +1265,159 @@ bool SearchProgressInfo::rxCounting() {
 }
 
 
+// Count regular expression matches using worker threads, each searching pieces of the search regions in a snapshot of the
+// document with its own copy of the expression.  Pieces begin at line boundaries.  The search for a piece sees the text only up
+// to its bound, a line boundary at least one piece length past its end (or the end of the region), so the work for each piece is
+// limited even when matches are sparse; this assumes that no match, and no alternative the expression tries before finding one,
+// extends that far.  A match which reaches the bound may have been cut short, so the worker stops there and leaves the rest of
+// the piece to the merge.  Expressions with assertions about the end of the text are not counted this way, since they would be
+// true at the bound.  Returns false if threads are not to be used.
+
+bool SearchProgressInfo::startParallelCounting() {
+
+    auto& sci = data.sci;
+    auto& searchData = data.searchData;
+    const std::wstring& pattern   = searchData.findHistory.back();
+    const intptr_t      chunkSize = std::max(searchData.countChunkSize, 16) * intptr_t(1024);
+    unsigned int threads = searchData.countThreads > 0 ? searchData.countThreads : std::thread::hardware_concurrency();
+    if ( threads < 2 || usesK || !rx.can_search() || partialEnd - partialStart < 2 * chunkSize
+      || pattern.find(L"\\G") != std::wstring::npos /* a match at \G depends on where the search began */
+      || pattern.find(L"\\z") != std::wstring::npos || pattern.find(L"\\Z") != std::wstring::npos
+      || pattern.find(L"\\'") != std::wstring::npos ) return false;
+
+    const DocumentSnapshot text(sci);
+    auto lineBoundary = [&](Scintilla::Position p, Scintilla::Position regionEnd) {
+        while (p < regionEnd && !(text.at(p - 1) == '\n' || (text.at(p - 1) == '\r' && text.at(p) != '\n'))) ++p;
+        return p;
+    };
+    std::vector<CountPiece> pieces;
+    for (Scintilla::Position p = partialStart; p < partialEnd;) {
+        if (!sci.IndicatorValueAt(searchData.indicator, p)) {
+            const Scintilla::Position next = sci.IndicatorEnd(searchData.indicator, p);
+            if (next <= p) break;
+            p = next;
+            continue;
+        }
+        const Scintilla::Position regionStart = sci.IndicatorStart(searchData.indicator, p);
+        const Scintilla::Position regionEnd   = sci.IndicatorEnd  (searchData.indicator, p);
+        const Scintilla::Position limit       = std::min(regionEnd, partialEnd);
+        for (Scintilla::Position from = p; from < limit;) {
+            const Scintilla::Position until = from + chunkSize >= limit     ? regionEnd : lineBoundary(from + chunkSize, regionEnd);
+            const Scintilla::Position bound = until + chunkSize >= regionEnd ? regionEnd : lineBoundary(until + chunkSize, regionEnd);
+            pieces.push_back({ regionStart, regionEnd, from, until, bound, from == p });
+            from = until;
+        }
+        p = regionEnd;
+    }
+    if (pieces.size() < 2) return false;
+    threads = static_cast<unsigned int>(std::min(static_cast<size_t>(threads), pieces.size()));
+
+    countPieces = std::move(pieces);
+    countNext   = 0;
+    countMatchers.clear();
+    for (unsigned int i = 0; i < threads; ++i) {
+        countMatchers.push_back(std::make_unique<RegularExpression>(sci));
+        countMatchers.back()->find(pattern, searchData.matchCase);
+        countMatchers.back()->set_text(text.pt1, text.pt2, text.gap, text.end);
+    }
+    return true;
+
+}
+
+
+// Search for a match from p, seeing the text only up to the bound of piece.
+
+SearchProgressInfo::CountFound SearchProgressInfo::countFrom(RegularExpression& matcher, const CountPiece& piece, Scintilla::Position p) {
+    if (!matcher.search(p, piece.bound, piece.regionStart))
+        return piece.bound == piece.regionEnd ? CountFound{ p, piece.regionEnd, -1 } : CountFound{ p, piece.until, -2 };
+    const Scintilla::Position start  = matcher.position(0);
+    const Scintilla::Position length = matcher.length();
+    if (piece.bound < piece.regionEnd) {
+        if (start >= piece.until) return { p, piece.until, -2 };  // it might not be the same in the whole text; the next piece will find it
+        if (start + length >= piece.bound) return { p, start, -3 };  // it might have been cut short
+    }
+    return { p, start, length };
+}
+
+
+// Search one round of pieces (two for each worker) and merge the results as a single search from the beginning would find them:
+// a match found from a piece is accepted when the search that found it began at or before the point the merged search has reached
+// and the match begins at or after that point.  Where there is no such match (because an earlier match in the piece overlapped a
+// match the merged search accepted, or because the worker stopped at its bound), the merged search continues on this thread from
+// that point (it, too, sees the text only to the bound, unless a match reaches it), and returns to the worker's results as soon as
+// it reaches a point from which a worker searched.  This runs as the task of searchMultiple, so the usual progress dialog is shown,
+// and the count can be cancelled, between rounds.
+
+bool SearchProgressInfo::rxCountingParallel() {
+
+    auto& sci = data.sci;
+    const size_t roundEnd = std::min(countNext + 2 * countMatchers.size(), countPieces.size());
+    std::vector<std::vector<CountFound>> results(roundEnd - countNext);
+    std::atomic<size_t> nextPiece = countNext;
+    auto work = [&](RegularExpression& matcher) {
+        for (size_t i; (i = nextPiece++) < roundEnd;) {
+            const CountPiece& piece = countPieces[i];
+            std::vector<CountFound>& found = results[i - countNext];
+            for (Scintilla::Position p = piece.from; p < piece.until;) {
+                const CountFound f = countFrom(matcher, piece, p);
+                if (f.length == -3) break;  // the merge will search from here
+                found.push_back(f);
+                if (f.length < 0 || f.start >= piece.until) break;
+                p = f.length ? f.start + f.length : f.start + 1;
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < countMatchers.size(); ++i) workers.emplace_back(work, std::ref(*countMatchers[i]));
+    work(*countMatchers[0]);
+    for (auto& worker : workers) worker.join();
+
+    Scintilla::Position& p = position;
+    for (size_t i = countNext; i < roundEnd; ++i) {
+        const CountPiece& piece = countPieces[i];
+        const std::vector<CountFound>& found = results[i - countNext];
+        if (piece.first) p = piece.from;
+        for (size_t j = 0; p < piece.until;) {
+            while (j < found.size() && found[j].start < p) ++j;  // results are in order; these matches were passed over
+            CountFound f;
+            if (j < found.size() && found[j].origin <= p) f = found[j++];
+            else {
+                f = countFrom(rx, piece, p);
+                if (f.length == -3) {
+                    f = { p, piece.regionEnd, -1 };
+                    if (rx.search(p, piece.regionEnd, piece.regionStart)) f = { p, rx.position(0), rx.length() };
+                }
+            }
+            const Scintilla::Position start  = f.start;
+            const Scintilla::Position length = f.length;
+            if (length == -2) {
+                p = piece.until;
+                break;
+            }
+            if (length < 0) {
+                p = piece.regionEnd;
+                if (p >= partialEnd) return false;
+                break;
+            }
+            if (start + length > partialEnd) return false;
+            p = length ? start + length : start + 1;
+            ++count;
+            if (selecting) if (count == 1) sci.SetSel(start, start + length);
+                                   else sci.AddSelection(start + length, start);
+            if (p >= partialEnd) return false;
+        }
+    }
+    countNext = roundEnd;
+    return countNext < countPieces.size();
+
+}
+
+
 bool SearchProgressInfo::scReplacing() {
     auto& sci = data.sci;
     auto& searchData = data.searchData;
     if (!sci.IndicatorValueAt(searchData.indicator, position)) {
+        applyReplacements();  // the batch must not extend beyond the search region
         position = sci.IndicatorEnd(searchData.indicator, position);
         if (position >= partialEnd) return false;
     }
@@ -1205,20 +1428,17 @@ bool SearchProgressInfo::scReplacing() {
         position = sci.TargetEnd();
         if (position > partialEnd) return false;
         ++count;
-        Scintilla::Position oldLength = position - found;
-        Scintilla::Position newLength = sci.ReplaceTarget(replace[0]);
-        position     += newLength - oldLength;
-        indicatorEnd += newLength - oldLength;
-        partialEnd   += newLength - oldLength;
-        sci.SetIndicatorCurrent(searchData.indicator);
-        sci.SetIndicatorValue(1);
-        sci.IndicatorFillRange(found, newLength);
+        addReplacement(found, position - found, replace[0]);
+        if (!batching) applyReplacements();
     }
     else if (found < -1) {
         showSearchError(data, found);
         return false;
     }
-    else position = indicatorEnd;
+    else {
+        position = indicatorEnd;
+        applyReplacements();
+    }
     return position < partialEnd;
 }
 
@@ -1231,11 +1451,11 @@ bool SearchProgressInfo::rxReplacing() {
         start = sci.IndicatorStart(searchData.indicator, position);
     }
     else {
+        applyReplacements();  // the batch must not extend beyond the search region
         position = start = sci.IndicatorEnd(searchData.indicator, position);
         if (position >= partialEnd) return false;
     }
     Scintilla::Position indicatorEnd = sci.IndicatorEnd(searchData.indicator, position);
-    rx.invalidate();
     if (rx.search(position, indicatorEnd, start)) {
         Scintilla::Position found  = rx.position(0);
         Scintilla::Position length = rx.length();
@@ -1252,16 +1472,65 @@ bool SearchProgressInfo::rxReplacing() {
         else position = found + length;
         if (found + length > partialEnd) return false;
         ++count;
-        std::string r = rx.format(replace.size() == 1 ? replace[0] : calculateSubstitutions(data, rx, found));
-        sci.SetTargetRange(found, found + length);
-        sci.ReplaceTarget(r);
-        position     += r.length() - length;
-        indicatorEnd += r.length() - length;
-        partialEnd   += r.length() - length;
-        sci.SetIndicatorCurrent(searchData.indicator);
-        sci.SetIndicatorValue(1);
-        sci.IndicatorFillRange(found, r.length());
+        const bool calculated = replace.size() > 1;
+        std::string r = rx.format(calculated ? calculateSubstitutions(data, rx, found) : replace[0]);
+        const bool apply = !batching || (calculated /* line numbers must be current for the next match */
+                        && (r.find_first_of("\r\n") != std::string::npos || rx.str(0).find_first_of("\r\n") != std::string::npos));
+        addReplacement(found, length, r);
+        if (apply) applyReplacements();
+    }
+    else {
+        position = indicatorEnd;
+        applyReplacements();
     }
-    else position = indicatorEnd;
     return position < partialEnd;
 }
+
+
+// Adds the replacement of length characters at found by r to the batch of pending replacements.  Replacing a range of text makes
+// Scintilla remove every line in it after the first, which would move markers such as bookmarks on those lines to the first; so if
+// this match ends on or after a line with a marker, the pending replacements are applied first.
+
+void SearchProgressInfo::addReplacement(Scintilla::Position found, Scintilla::Position length, const std::string& r) {
+    auto& sci = data.sci;
+    std::string buffer;
+    if (batchStart >= 0) {
+        if (batchMarker < 0 || sci.LineFromPosition(found + length) < batchMarker)
+            batch.append(batchText.contiguous(batchEnd, found, buffer), found - batchEnd);
+        else {
+            const Scintilla::Position before = position;
+            applyReplacements();
+            found += position - before;
+        }
+    }
+    if (batchStart < 0) {
+        batchStart  = batchEnd = found;
+        batchText   = DocumentSnapshot(sci);
+        batchMarker = batching ? sci.MarkerNext(sci.LineFromPosition(found) + 1, -1) : -1;
+        batch.clear();
+    }
+    batch += r;
+    batchEnd = found + length;
+    if (batch.length() > batchLimit) applyReplacements();
+}
+
+
+// Replaces the document text from batchStart to batchEnd with the batch, and marks the new text as part of the search region.
+
+void SearchProgressInfo::applyReplacements() {
+    if (batchStart < 0) return;
+    auto& sci = data.sci;
+    sci.SetTargetRange(batchStart, batchEnd);
+    sci.ReplaceTarget(batch);
+    const Scintilla::Position shift = static_cast<Scintilla::Position>(batch.length()) - (batchEnd - batchStart);
+    if (firstChange < 0) firstChange = batchStart;
+    lastChange  = batchStart + batch.length();
+    position   += shift;
+    partialEnd += shift;
+    sci.SetIndicatorCurrent(data.searchData.indicator);
+    sci.SetIndicatorValue(1);
+    sci.IndicatorFillRange(batchStart, batch.length());
+    batchStart = -1;
+    batch.clear();
+    rx.invalidate();
+}
@@ -189,4 +189,23 @@ void ColumnsPlusPlusData::buildSelectionMenu(int selectionItemIndex, int selecti
     InsertMenuItem(cppMenu, selectionMenuIndex, TRUE, &cmi);
     DrawMenuBar(nppData._nppHandle);
 
-}
\ No newline at end of file
+}
+
+
+// Whole Column makes the tab-delimited column containing the caret, on every line of the document, the target of the next column
+// command, without making a selection (see VirtualRectangle); choosing it again cancels the target, as does activating another
+// document.  The menu item is checked while the target is set.
+
+void ColumnsPlusPlusData::targetWholeColumn() {
+    if (rectangularTarget) rectangularTarget.reset();
+    else {
+        const Scintilla::Position caret = sci.CurrentPos();
+        const DocumentSnapshot text(sci);
+        Scintilla::Position p = sci.PositionFromLine(sci.LineFromPosition(caret));
+        if (settings.elasticEnabled && settings.leadingTabsIndent) while (p < caret && text.at(p) == '\t') ++p;
+        int column = 1;
+        for (; p < caret; ++p) if (text.at(p) == '\t') ++column;
+        rectangularTarget = VirtualRectangle::wholeColumn(column);
+    }
+    SendMessage(nppData._nppHandle, NPPM_SETMENUITEMCHECK, wholeColumnMenuItem, rectangularTarget ? TRUE : FALSE);
+}
@@ -97,12 +97,13 @@ void replaceSortSelection(ColumnsPlusPlusData& data, SortSelection& ss, const Re
     data.sci.ReplaceTarget(r);
     if (data.settings.elasticEnabled) {
         DocumentData* ddp = data.getDocument();
-        data.analyzeTabstops(*ddp);
+        data.analyzeTabstops(*ddp, ss.textLine, ss.textLine + lines - 1, 0);
         Scintilla::Line firstVisible = data.sci.FirstVisibleLine();
         Scintilla::Line lastVisible = firstVisible + data.sci.LinesOnScreen();
         data.setTabstops(*ddp, std::min(ss.textLine, firstVisible), std::max(ss.textLine + lines - 1, lastVisible));
     }
 
+    if (rs.isVirtual()) return;  // there is no selection to restore
     cpTop    += ss.textStart;
     cpBottom += data.sci.PositionFromLine(ss.textLine + lines - 1);
     data.sci.SetRectangularSelectionAnchor            (topToBottom ? cpTop    : cpBottom);
@@ -139,12 +140,13 @@ void replaceSortColumn(ColumnsPlusPlusData& data, const SortSelection& ss, const
     data.sci.ReplaceTarget(r);
     if (data.settings.elasticEnabled) {
         DocumentData* ddp = data.getDocument();
-        data.analyzeTabstops(*ddp);
+        data.analyzeTabstops(*ddp, ss.textLine, ss.textLine + lines - 1, 0);
         Scintilla::Line firstVisible = data.sci.FirstVisibleLine();
         Scintilla::Line lastVisible = firstVisible + data.sci.LinesOnScreen();
         data.setTabstops(*ddp, std::min(ss.textLine, firstVisible), std::max(ss.textLine + lines - 1, lastVisible));
     }
 
+    if (rs.isVirtual()) return;  // there is no selection to restore
     cpTop    += ss.textStart;
     cpBottom += data.sci.PositionFromLine(ss.textLine + lines - 1);
     data.sci.SetRectangularSelectionAnchor            (topToBottom ? cpTop    : cpBottom);
@@ -257,7 +259,7 @@ void sortCommon(ColumnsPlusPlusData& data, const SortSettings& sortSettings, Rec
             cellStart.emplace_back(row.cpMin());
             cellEnd  .emplace_back(row.cpMax());
             for (const auto& cell : row) {
-                cellText .push_back(cell.text());
+                cellText .emplace_back(cell.text());
                 cellStart.push_back(cell.start());
                 cellEnd  .push_back(cell.end());
             }
@@ -0,0 +1,187 @@
+// This file is part of Columns++ for Notepad++.
+// Copyright 2026 by Randall Joseph Fellmy <software@coises.com>, <http://www.coises.com/software/>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// Scanning of lines for tabs and line ends directly in the Scintilla buffer.  Runs of ASCII text are examined 32 bytes at a time
+// with AVX2 when the processor supports it, or 16 bytes at a time with SSE2 (always available in x86 and x64 Windows builds);
+// other builds, and any text containing bytes outside the ASCII range, use the scalar code.  Debug builds check every result of
+// the vector code against the scalar code.
+
+#include "ColumnsPlusPlus.h"
+#include <bit>
+#include <cassert>
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#define COLUMNSPP_SSE2
+#endif
+#if defined(_M_X64)
+#define COLUMNSPP_AVX2
+#endif
+
+namespace {
+
+// Returns the length of the character at s, counting as Scintilla's Document::NextPosition does:
+// each byte of an invalid or non-character utf-8 sequence is a separate character.
+
+size_t characterLength(const unsigned char* s, size_t available) {
+    const unsigned char c1 = s[0];
+    if (c1 < 0x80) return 1;
+    const size_t n = c1 < 0xC2 ? 1 : c1 < 0xE0 ? 2 : c1 < 0xF0 ? 3 : c1 < 0xF5 ? 4 : 1;
+    if (n == 1 || n > available) return 1;
+    const unsigned char c2 = s[1];
+    if ((c2 & 0xC0) != 0x80) return 1;
+    if (n == 2) return 2;
+    const unsigned char c3 = s[2];
+    if ((c3 & 0xC0) != 0x80) return 1;
+    if (n == 3) {
+        if (c1 == 0xE0 && (c2 & 0xE0) == 0x80) return 1;                                  // overlong
+        if (c1 == 0xED && (c2 & 0xE0) == 0xA0) return 1;                                  // surrogate
+        if (c1 == 0xEF && c2 == 0xBF && (c3 == 0xBE || c3 == 0xBF)) return 1;             // U+FFFE, U+FFFF
+        if (c1 == 0xEF && c2 == 0xB7 && ((c3 & 0xF0) == 0x90 || (c3 & 0xF0) == 0xA0)) return 1;  // U+FDD0 - U+FDEF
+        return 3;
+    }
+    const unsigned char c4 = s[3];
+    if ((c4 & 0xC0) != 0x80) return 1;
+    if ((c2 & 0x0F) == 0x0F && c3 == 0xBF && (c4 == 0xBE || c4 == 0xBF)) return 1;        // U+xFFFE, U+xFFFF
+    if (c1 == 0xF4 ? c2 > 0x8F : c1 == 0xF0 && (c2 & 0xF0) == 0x80) return 1;             // beyond U+10FFFF or overlong
+    return 4;
+}
+
+#ifdef COLUMNSPP_AVX2
+const bool haveAVX2 = IsProcessorFeaturePresent(PF_AVX2_INSTRUCTIONS_AVAILABLE);
+#endif
+
+// Scalar code for plainRun and lineEndOffset, starting at offset i.
+
+size_t plainRunScalar(const char* s, size_t n, bool utf8, size_t i) {
+    for (; i < n; ++i) if (s[i] == '\t' || (utf8 && (s[i] & 0x80))) break;
+    return i;
+}
+
+size_t lineEndOffsetScalar(const char* s, size_t n, size_t i) {
+    for (; i < n; ++i) if (s[i] == '\r' || s[i] == '\n') break;
+    return i;
+}
+
+size_t plainRunVector(const char* s, size_t n, bool utf8) {
+    size_t i = 0;
+#ifdef COLUMNSPP_AVX2
+    if (haveAVX2) {
+        const __m256i tab = _mm256_set1_epi8('\t');
+        for (; i + 32 <= n; i += 32) {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+            uint32_t stops = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, tab)));
+            if (utf8) stops |= static_cast<uint32_t>(_mm256_movemask_epi8(v));
+            if (stops) return i + std::countr_zero(stops);
+        }
+    }
+#endif
+#ifdef COLUMNSPP_SSE2
+    const __m128i tab = _mm_set1_epi8('\t');
+    for (; i + 16 <= n; i += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        uint32_t stops = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, tab)));
+        if (utf8) stops |= static_cast<uint32_t>(_mm_movemask_epi8(v));
+        if (stops) return i + std::countr_zero(stops);
+    }
+#endif
+    return plainRunScalar(s, n, utf8, i);
+}
+
+size_t lineEndOffsetVector(const char* s, size_t n) {
+    size_t i = 0;
+#ifdef COLUMNSPP_AVX2
+    if (haveAVX2) {
+        const __m256i cr = _mm256_set1_epi8('\r');
+        const __m256i lf = _mm256_set1_epi8('\n');
+        for (; i + 32 <= n; i += 32) {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+            const uint32_t stops = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, cr),
+                                                                                               _mm256_cmpeq_epi8(v, lf))));
+            if (stops) return i + std::countr_zero(stops);
+        }
+    }
+#endif
+#ifdef COLUMNSPP_SSE2
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    for (; i + 16 <= n; i += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        const uint32_t stops = static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, lf))));
+        if (stops) return i + std::countr_zero(stops);
+    }
+#endif
+    return lineEndOffsetScalar(s, n, i);
+}
+
+// Returns the number of bytes from s which are neither tabs nor (if utf8 is set) outside the ASCII range, examining at most n bytes.
+
+size_t plainRun(const char* s, size_t n, bool utf8) {
+    const size_t run = plainRunVector(s, n, utf8);
+    assert(run == plainRunScalar(s, n, utf8, 0));
+    return run;
+}
+
+// Returns the offset of the first CR or LF in the n bytes at s, or n if there is none.
+
+size_t lineEndOffset(const char* s, size_t n) {
+    const size_t offset = lineEndOffsetVector(s, n);
+    assert(offset == lineEndOffsetScalar(s, n, 0));
+    return offset;
+}
+
+} // end unnamed namespace
+
+
+// Find the tabs in the text from begin to end (which must not include a line end) and count the characters in each cell.
+// If eolTab is set, the end of the text is treated as a tab.  Counts are valid only when the text is utf-8 or single-byte.
+
+void TabScanner::scan(const DocumentSnapshot& text, intptr_t begin, intptr_t end, bool eolTab) {
+    cells.clear();
+    const char*  s      = text.contiguous(begin, end, buffer);
+    const size_t n      = end - begin;
+    size_t       start  = 0;
+    int          count  = 0;
+    for (size_t i = 0; i < n;) {
+        const size_t run = plainRun(s + i, n - i, text.utf8);
+        i     += run;
+        count += static_cast<int>(run);
+        if (i >= n) break;
+        if (s[i] == '\t') {
+            cells.push_back({ start, i, count });
+            start = ++i;
+            count = 0;
+        }
+        else {
+            i += characterLength(reinterpret_cast<const unsigned char*>(s + i), n - i);
+            ++count;
+        }
+    }
+    if (eolTab) cells.push_back({ start, n, count });
+}
+
+
+// Returns the position of the first CR or LF at or after from and before limit, or limit if there is none.
+
+intptr_t TabScanner::findLineEnd(const DocumentSnapshot& text, intptr_t from, intptr_t limit) {
+    if (from < text.gap) {
+        const intptr_t stop = std::min(limit, text.gap);
+        const intptr_t p    = from + static_cast<intptr_t>(lineEndOffset(text.pt1 + from, stop - from));
+        if (p < stop || stop == limit) return p;
+        from = stop;
+    }
+    return from + static_cast<intptr_t>(lineEndOffset(text.pt2 + from, limit - from));
+}
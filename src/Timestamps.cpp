@@ -559,14 +559,14 @@ void ColumnsPlusPlusData::convertTimestamps() {
             replaceCell.isLastInRow = cell.isLastInRow();
             replaceCell.isEndOfLine = cell.isEndOfLine();
             if (timestamps.overwrite) {
-                const std::string text = cell.text();
+                const std::string_view text = cell.text();
                 const size_t n = text.find_last_not_of(' ');
-                if (n == std::string::npos) continue;
+                if (n == std::string_view::npos) continue;
                 replaceCell.text = text.substr(0, n + 1);
             }
             else if (cell.isLastInRow() && cell.text().back() != ' ') needsSpace = true;
 
-            const std::string source = cell.trim();
+            const std::string source(cell.trim());
             int64_t counter = 0;
 
             bool sourceIsCounter  = false;
@@ -274,6 +274,8 @@
 #define IDC_TIMESTAMP_OVERWRITE         1299
 #define IDC_SEARCH_PROGRESS_BAR         1300
 #define IDC_SEARCH_PROGRESS_MESSAGE     1301
+#define IDC_OPTIONS_ELASTIC_STREAMING   1302
+#define IDC_ABOUT_STATISTICS            1303
 
 // Next default values for new objects
 // 
@@ -281,7 +283,7 @@
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NEXT_RESOURCE_VALUE        144
 #define _APS_NEXT_COMMAND_VALUE         40001
-#define _APS_NEXT_CONTROL_VALUE         1302
+#define _APS_NEXT_CONTROL_VALUE         1304
 #define _APS_NEXT_SYMED_VALUE           101
 #endif
 #endif